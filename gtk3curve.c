@@ -26,6 +26,8 @@
 #include <gtk/gtk.h>
 
 #include "gtk3curve.h"
+#include "gtk3curvekernels.h"
+#include "gtk3curveinterp.h"
 
 #ifdef DEBUG
 #define DEBUG_INFO g_print
@@ -36,6 +38,7 @@
 #endif
 
 static guint                curve_type_changed_signal = 0;
+static guint                changed_signal = 0;
 static gint                 Gtk3Curve_private_offset = 0;
 static GtkDrawingAreaClass *gtk3_curve_parent_class = NULL;
 
@@ -47,6 +50,9 @@ static GtkDrawingAreaClass *gtk3_curve_parent_class = NULL;
 
 #define RADIUS            3 /* radius of the control points */
 #define MIN_DISTANCE      8 /* min distance between control points */
+#define PATH_TOLERANCE    0.5  /* max distance of dropped curve pixels to the stroked path */
+#define PATH_BLOCK       64 /* curve pixels decimated on their own, see gtk3_curve_update_path */
+#define BULLET_EXTENT    (RADIUS * 2) /* half the size of the area a control point covers */
 #define GRAPH_MASK       (GDK_EXPOSURE_MASK | \
                           GDK_POINTER_MOTION_MASK | \
                           GDK_POINTER_MOTION_HINT_MASK | \
@@ -56,6 +62,12 @@ static GtkDrawingAreaClass *gtk3_curve_parent_class = NULL;
                           GDK_BUTTON_RELEASE_MASK | \
                           GDK_BUTTON1_MOTION_MASK)
 
+/* what the next draw has to bring up to date, see priv->dirty */
+#define DIRTY_GEOMETRY   (1 << 0) /* size changed */
+#define DIRTY_POINTS     (1 << 1) /* curve changed while it could not be interpolated */
+#define DIRTY_STYLE      (1 << 2) /* colors, grid or theme changed */
+#define DIRTY_ALL        (DIRTY_GEOMETRY | DIRTY_POINTS | DIRTY_STYLE)
+
 struct _Gtk3CurvePrivate
 {
   GdkWindow *event_window;
@@ -63,10 +75,9 @@ struct _Gtk3CurvePrivate
 
   gint cursor_type;
 
-  gfloat min_x;
-  gfloat max_x;
-  gfloat min_y;
-  gfloat max_y;
+  Gtk3CurveModel *model;
+  gulong model_changed_id;
+  gulong model_notify_id;
 
   gboolean use_bg_theme;
 
@@ -83,11 +94,67 @@ struct _Gtk3CurvePrivate
   gint grab_point;
   gint last;
 
+  /* pointer state of the last motion event, applied once per frame */
+  gint motion_x;
+  gint motion_y;
+  GdkModifierType motion_state;
+  guint tick_id;
+
   Gtk3CurveGridSize grid_size;
   Gtk3CurveData curve_data;
 
+  /* curve values behind curve_data.d_point, kept to avoid reallocating */
+  gfloat *vector;
+  /* curve_data.d_point without the points the stroke does not need */
+  Gtk3CurvePoint *path;
+  gint n_path;
+  /* model revision they were evaluated at, 0 if none */
+  guint revision;
+  /* bound on how far they lag behind, in curve units, from spline spans
+   * left out of local updates */
+  gfloat stale;
+
+  /* active control points as last drawn, in widget coordinates and by
+   * increasing x, and their index in the model */
+  Gtk3CurvePoint *bullets;
+  gint *bullet_index;
+  gint n_bullets;
+
+  /* what the next "changed" reports: [changed_x1, changed_x2] of the
+   * model changed up to changed_revision; emitted once per frame */
+  guint changed_revision;
+  gfloat changed_x1;
+  gfloat changed_x2;
+  guint changed_tick_id;
+
+  /* nesting of gtk3_curve_begin_update and the model it batches */
+  gint freeze_count;
+  Gtk3CurveModel *frozen_model;
+
+  /* range properties set but not applied yet, by PROP_MIN_X + i for bit
+   * i of range_set_mask; see gtk3_curve_dispatch_properties_changed.
+   * range_notified has those being applied, already notified. */
+  gfloat range_set[4];
+  guint range_set_mask;
+  guint range_notified;
+
+  /* DIRTY_* flags, a draw with none set only repaints */
+  guint dirty;
+  /* area the interpolations since the last gtk3_curve_queue_damage changed */
+  cairo_region_t *damage;
+
+  /* background and grid, the curve is drawn over a copy of it */
+  cairo_surface_t *backing_store;
+  gboolean         backing_store_valid;
+
   guint state                 : 1;
   guint in_curve              : 1;
+  guint motion_pending        : 1;
+  /* held back by gtk3_curve_begin_update */
+  guint pending_changed       : 1;
+  guint pending_size          : 1;
+  guint pending_draw          : 1;
+  guint changed_pending       : 1;
 };
 
 enum
@@ -97,7 +164,8 @@ enum
   PROP_MIN_X,
   PROP_MAX_X,
   PROP_MIN_Y,
-  PROP_MAX_Y
+  PROP_MAX_Y,
+  PROP_MODEL
 };
 
 static void gtk3_curve_realize              (GtkWidget            *widget);
@@ -105,7 +173,6 @@ static void gtk3_curve_unrealize            (GtkWidget            *widget);
 static void gtk3_curve_style_updated        (GtkWidget            *widget);
 static void gtk3_curve_size_allocate        (GtkWidget            *widget,
                                              GtkAllocation        *allocation);
-static void gtk3_curve_configure            (Gtk3Curve            *curve);
 static gboolean gtk3_curve_draw             (GtkWidget            *widget,
                                              cairo_t              *cr);
 static void gtk3_curve_map                  (GtkWidget            *widget);
@@ -120,6 +187,14 @@ static gboolean gtk3_curve_button_release   (GtkWidget            *widget,
                                              GdkEventButton       *event);
 static gboolean gtk3_curve_motion_notify    (GtkWidget            *widget,
                                              GdkEventMotion       *event);
+static gboolean gtk3_curve_tick             (GtkWidget            *widget,
+                                             GdkFrameClock        *frame_clock,
+                                             gpointer              user_data);
+static void gtk3_curve_flush_motion         (GtkWidget            *widget);
+static void gtk3_curve_apply_motion         (GtkWidget            *widget,
+                                             gint                  tx,
+                                             gint                  ty,
+                                             GdkModifierType       state);
 static void gtk3_curve_screen_changed       (GtkWidget            *widget,
                                              GdkScreen            *prev_screen);
 static void gtk3_curve_style_updated        (GtkWidget            *widget);
@@ -133,40 +208,65 @@ static void gtk3_curve_set_property         (GObject              *object,
                                              guint                 param_id,
                                              const GValue         *value,
                                              GParamSpec           *pspec);
+static void gtk3_curve_dispatch_properties_changed (GObject         *object,
+                                                    guint            n_pspecs,
+                                                    GParamSpec     **pspecs);
+static void gtk3_curve_get_range_set        (Gtk3Curve            *curve,
+                                             gfloat                range[4]);
+static void gtk3_curve_apply_range_set      (Gtk3Curve            *curve);
 static void gtk3_curve_size_graph           (Gtk3Curve            *curve);
 static void gtk3_curve_create_layouts       (GtkWidget            *widget);
-static void gtk3_curve_reset_vector         (GtkWidget            *widget);
+static void gtk3_curve_invalidate           (Gtk3Curve            *curve,
+                                             guint                 dirty);
+static void gtk3_curve_make_pixmap          (Gtk3Curve            *curve);
+static void gtk3_curve_draw_background      (Gtk3Curve            *curve);
+static void gtk3_curve_queue_damage         (Gtk3Curve            *curve);
 static void gtk3_curve_interpolate          (GtkWidget            *widget,
                                              gint                  width,
                                              gint                  height);
+static void gtk3_curve_update_bullets       (Gtk3Curve            *curve,
+                                             gint                  width,
+                                             gint                  height);
+static void gtk3_curve_update_path          (Gtk3CurvePrivate     *priv);
+static gboolean gtk3_curve_has_points      (Gtk3Curve            *curve);
+static gint gtk3_curve_find_point           (Gtk3Curve            *curve,
+                                             gint                  x,
+                                             gint                  y,
+                                             gint                 *insert);
+static void gtk3_curve_model_changed        (Gtk3CurveModel       *model,
+                                             Gtk3Curve            *curve);
+static void gtk3_curve_note_change          (Gtk3Curve            *curve);
+static void gtk3_curve_emit_changed         (Gtk3Curve            *curve);
+static gboolean gtk3_curve_changed_tick     (GtkWidget            *widget,
+                                             GdkFrameClock        *frame_clock,
+                                             gpointer              user_data);
+static void gtk3_curve_model_notify         (Gtk3CurveModel       *model,
+                                             GParamSpec           *pspec,
+                                             Gtk3Curve            *curve);
 static int project                          (gfloat                value,
                                              gfloat                min,
                                              gfloat                max,
                                              int                   norm);
+static gint decimate                        (const Gtk3CurvePoint *point,
+                                             gint                  n,
+                                             gfloat                tolerance,
+                                             Gtk3CurvePoint       *path);
+static gint path_find                       (const Gtk3CurvePoint *path,
+                                             gint                  n,
+                                             gint                  x);
 static gfloat unproject                     (gint                  value,
                                              gfloat                min,
                                              gfloat                max,
                                              int                   norm);
-static void spline_solve                    (int                   n,
-                                             gfloat                x[],
-                                             gfloat                y[],
-                                             gfloat                y2[]);
-static gfloat spline_eval                   (int                   n,
-                                             gfloat                x[],
-                                             gfloat                y[],
-                                             gfloat                y2[],
-                                             gfloat                val);
-static void gtk3_curve_draw_line            (cairo_t              *cr,
-                                             gdouble               x1,
-                                             gdouble               y1,
-                                             gdouble               x2,
-                                             gdouble               y2);
 static void gtk3_curve_class_init           (Gtk3CurveClass       *klass);
 static void gtk3_curve_init                 (Gtk3Curve            *self);
 
 static void gtk3_curve_get_cursor_coord     (GtkWidget            *widget,
+                                             GdkEvent             *event,
                                              gint                 *tx,
                                              gint                 *ty);
+static GdkCursor *gtk3_curve_get_cursor     (GtkWidget            *widget,
+                                             GdkCursorType         type);
 
 static inline gpointer
 gtk3_curve_get_instance_private (Gtk3Curve *self)
@@ -210,25 +310,6 @@ gtk3_curve_get_type (void)
   return curve_type;
 }
 
-GType
-gtk3_curve_type_get_type (void)
-{
-  static GType etype = 0;
-  if (G_UNLIKELY(etype == 0))
-    {
-      static const GEnumValue values[] =
-      {
-        { GTK3_CURVE_TYPE_LINEAR, "GTK3_CURVE_TYPE_LINEAR", "linear" },
-        { GTK3_CURVE_TYPE_SPLINE, "GTK3_CURVE_TYPE_SPLINE", "spline" },
-        { GTK3_CURVE_TYPE_FREE, "GTK3_CURVE_TYPE_FREE", "free" },
-        { 0, NULL, NULL }
-      };
-      etype = g_enum_register_static (g_intern_static_string ("Gtk3CurveType"),
-                                      values);
-    }
-  return etype;
-}
-
 static void
 gtk3_curve_class_init (Gtk3CurveClass* klass)
 {
@@ -271,6 +352,8 @@ gtk3_curve_class_init (Gtk3CurveClass* klass)
   gobject_class->dispose = gtk3_curve_dispose;
   gobject_class->set_property = gtk3_curve_set_property;
   gobject_class->get_property = gtk3_curve_get_property;
+  gobject_class->dispatch_properties_changed =
+    gtk3_curve_dispatch_properties_changed;
 
   g_object_class_install_property (gobject_class,
                                    PROP_CURVE_TYPE,
@@ -316,6 +399,13 @@ gtk3_curve_class_init (Gtk3CurveClass* klass)
                                        G_MAXFLOAT,
                                        1.0,
                                        GTK3_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class,
+                                   PROP_MODEL,
+                                   g_param_spec_object ("model",
+                                       "Model",
+                                       "The curve model displayed and edited by the widget",
+                                       GTK3_TYPE_CURVE_MODEL,
+                                       GTK3_PARAM_READWRITE));
 
   curve_type_changed_signal =
     g_signal_new ("curve-type-changed",
@@ -326,6 +416,18 @@ gtk3_curve_class_init (Gtk3CurveClass* klass)
                   _gtk3_marshal_VOID__VOID,
                   G_TYPE_NONE, 0);
 
+  /* the part [x1, x2] of the x range that changed, up to the model
+   * revision given; at most once per frame */
+  changed_signal =
+    g_signal_new ("changed",
+                  G_OBJECT_CLASS_TYPE (gobject_class),
+                  G_SIGNAL_RUN_FIRST,
+                  G_STRUCT_OFFSET (Gtk3CurveClass, changed),
+                  NULL, NULL,
+                  NULL,
+                  G_TYPE_NONE, 3,
+                  G_TYPE_FLOAT, G_TYPE_FLOAT, G_TYPE_UINT);
+
   DEBUG_INFO("class_init [E]\n");
 }
 
@@ -346,9 +448,22 @@ gtk3_curve_init (Gtk3Curve* self)
   priv->curve_data.description = NULL;
   priv->curve_data.n_points = 0;
   priv->curve_data.d_point = NULL;
+  priv->vector = NULL;
+  priv->path = NULL;
+  priv->n_path = 0;
+  priv->revision = 0;
+  priv->stale = 0.0;
+  priv->bullets = NULL;
+  priv->bullet_index = NULL;
+  priv->n_bullets = 0;
+  priv->dirty = DIRTY_ALL;
+  priv->damage = cairo_region_create ();
+  priv->backing_store = NULL;
+  priv->backing_store_valid = FALSE;
   priv->curve_data.n_cpoints = 0;
   priv->curve_data.d_cpoints = NULL;
   priv->curve_data.curve_type = GTK3_CURVE_TYPE_SPLINE;
+  priv->curve_type = GTK3_CURVE_TYPE_SPLINE;
 
   /* Misc */
   priv->use_bg_theme = TRUE;
@@ -356,12 +471,22 @@ gtk3_curve_init (Gtk3Curve* self)
   priv->grid_size = GTK3_CURVE_GRID_LARGE;
   priv->height = 0;
   priv->grab_point = -1;
-
-  /* Min & Max range */
-  priv->min_x = 0.0;
-  priv->max_x = 1.0;
-  priv->min_y = 0.0;
-  priv->max_y = 1.0;
+  priv->tick_id = 0;
+  priv->motion_pending = FALSE;
+  priv->changed_revision = 0;
+  priv->changed_tick_id = 0;
+  priv->changed_pending = FALSE;
+  priv->freeze_count = 0;
+  priv->range_set_mask = 0;
+  priv->range_notified = 0;
+  priv->frozen_model = NULL;
+  priv->pending_changed = FALSE;
+  priv->pending_size = FALSE;
+  priv->pending_draw = FALSE;
+
+  /* Control points, range and evaluation */
+  priv->model = NULL;
+  gtk3_curve_set_model (GTK_WIDGET (self), NULL);
 
   /* Default Colors */
   gtk3_curve_set_color_background_rgba (GTK_WIDGET(self), 1.0, 1.0, 1.0, 1.0);
@@ -369,8 +494,6 @@ gtk3_curve_init (Gtk3Curve* self)
   gtk3_curve_set_color_grid_rgba (GTK_WIDGET(self), 0.0, 0.0, 0.0, 1.0);
   gtk3_curve_set_color_cpoint_rgba (GTK_WIDGET(self), 0.2, 0.2, 0.2, 1.0);
 
-  gtk3_curve_size_graph (self);
-
   DEBUG_INFO("init [E]\n");
 }
 
@@ -380,16 +503,21 @@ gtk3_curve_new()
   return g_object_new (GTK3_TYPE_CURVE, NULL);
 }
 
+GtkWidget *
+gtk3_curve_new_with_model (Gtk3CurveModel *model)
+{
+  return g_object_new (GTK3_TYPE_CURVE, "model", model, NULL);
+}
+
 static void
 gtk3_curve_style_updated (GtkWidget *widget)
 {
   GTK_WIDGET_CLASS (gtk3_curve_parent_class)->style_updated (widget);
 
   DEBUG_INFO("style_updated [S]\n");
-  if (gtk_widget_get_realized (widget) &&
-      gtk_widget_get_has_window (widget))
+  if (gtk_widget_get_realized (widget))
     {
-      gtk_widget_queue_draw (widget);
+      gtk3_curve_invalidate (GTK3_CURVE (widget), DIRTY_STYLE);
     }
   DEBUG_INFO("style_updated [E]\n");
 }
@@ -398,7 +526,6 @@ static void
 gtk3_curve_realize (GtkWidget *widget)
 {
   GtkAllocation allocation;
-  GdkWindow *window;
   GdkWindow *parent_window;
   GdkWindowAttr attributes;
   gint attributes_mask;
@@ -407,34 +534,43 @@ gtk3_curve_realize (GtkWidget *widget)
   priv = GTK3_CURVE (widget)->priv;
 
   DEBUG_INFO("realize [S]\n");
+  parent_window = gtk_widget_get_parent_window (widget);
+
+  gtk_widget_get_allocation (widget, &allocation);
+  DEBUG_INFO("allocation [%d,%d] [%dx%d]\n",
+          allocation.x,
+          allocation.y,
+          allocation.width,
+          allocation.height);
+
+  attributes.window_type = GDK_WINDOW_CHILD;
+  attributes.x = allocation.x;
+  attributes.y = allocation.y;
+  attributes.width = allocation.width;
+  attributes.height = allocation.height;
+  attributes.event_mask = gtk_widget_get_events (widget) |
+                          GRAPH_MASK;
+
   if (!gtk_widget_get_has_window (widget))
     {
+      /* windowless, draw on the parent window and take input through an
+       * input-only window over the allocation */
       GTK_WIDGET_CLASS (gtk3_curve_parent_class)->realize (widget);
+
+      attributes.wclass = GDK_INPUT_ONLY;
+      attributes_mask = GDK_WA_X | GDK_WA_Y;
+
+      priv->event_window = gdk_window_new (parent_window,
+                                           &attributes,
+                                           attributes_mask);
+      gtk_widget_register_window (widget, priv->event_window);
     }
   else
     {
       gtk_widget_set_realized (widget, TRUE);
-      parent_window = gtk_widget_get_parent_window (widget);
-      gtk_widget_set_window (widget, parent_window);
-      g_object_ref (parent_window);
-
-      gtk_widget_get_allocation (widget, &allocation);
-      DEBUG_INFO("allocation [%d,%d] [%dx%d]\n",
-              allocation.x,
-              allocation.y,
-              allocation.width,
-              allocation.height);
-
-      attributes.window_type = GDK_WINDOW_CHILD;
-      attributes.x = allocation.x;
-      attributes.y = allocation.y;
-      attributes.width = allocation.width;
-      attributes.height = allocation.height;
+
       attributes.wclass = GDK_INPUT_OUTPUT;
       attributes.visual = gtk_widget_get_visual (widget);
-      attributes.event_mask = gtk_widget_get_events (widget) |
-                              GRAPH_MASK;
-
       attributes_mask = GDK_WA_X | GDK_WA_Y | GDK_WA_VISUAL;
 
       priv->event_window = gdk_window_new (parent_window,
@@ -445,7 +581,7 @@ gtk3_curve_realize (GtkWidget *widget)
       gtk_widget_set_window (widget, priv->event_window);
     }
 
-  gtk3_curve_configure (GTK3_CURVE (widget));
+  gtk3_curve_make_pixmap (GTK3_CURVE (widget));
 
   DEBUG_INFO("realize [E]\n");
 }
@@ -456,14 +592,42 @@ gtk3_curve_unrealize (GtkWidget *widget)
   Gtk3CurvePrivate *priv = GTK3_CURVE (widget)->priv;
 
   DEBUG_INFO("unrealize [S]\n");
+  if (priv->tick_id)
+    {
+      gtk_widget_remove_tick_callback (widget, priv->tick_id);
+      priv->tick_id = 0;
+    }
+  priv->motion_pending = FALSE;
+
+  /* no more frames to wait for */
+  if (priv->changed_tick_id)
+    {
+      gtk_widget_remove_tick_callback (widget, priv->changed_tick_id);
+      priv->changed_tick_id = 0;
+    }
+  gtk3_curve_emit_changed (GTK3_CURVE (widget));
+
+  if (priv->backing_store)
+    {
+      cairo_surface_destroy (priv->backing_store);
+      priv->backing_store = NULL;
+    }
+  priv->backing_store_valid = FALSE;
+
+  /* with a window of its own the parent class destroys it */
   if (priv->event_window != NULL)
     {
-      DEBUG_INFO("unregister/destroy\n");
-      gtk_widget_unregister_window (widget, priv->event_window);
-      gdk_window_destroy (priv->event_window);
+      if (!gtk_widget_get_has_window (widget))
+        {
+          DEBUG_INFO("unregister/destroy\n");
+          gtk_widget_unregister_window (widget, priv->event_window);
+          gdk_window_destroy (priv->event_window);
+        }
       priv->event_window = NULL;
     }
 
+  GTK_WIDGET_CLASS (gtk3_curve_parent_class)->unrealize (widget);
+
   DEBUG_INFO("unrealize [E]\n");
 }
 
@@ -471,11 +635,20 @@ static void
 gtk3_curve_size_allocate (GtkWidget     *widget,
                           GtkAllocation *allocation)
 {
+  GtkAllocation widget_allocation;
+  gboolean resized;
+
   g_return_if_fail (GTK3_IS_CURVE (widget));
   g_return_if_fail (allocation != NULL);
 
   DEBUG_INFO("size_allocate [S]\n");
+  gtk_widget_get_allocation (widget, &widget_allocation);
+
+  resized = (widget_allocation.width  != allocation->width ||
+             widget_allocation.height != allocation->height);
+
   gtk_widget_set_allocation (widget, allocation);
+  GTK3_CURVE (widget)->priv->dirty |= DIRTY_GEOMETRY;
 
   DEBUG_INFO("allocation [%d,%d] [%dx%d]\n",
           allocation->x,
@@ -485,100 +658,64 @@ gtk3_curve_size_allocate (GtkWidget     *widget,
 
   if (gtk_widget_get_realized (widget))
     {
-      if (gtk_widget_get_has_window (widget))
-        {
-          gdk_window_move_resize (gtk_widget_get_window (widget),
-                                  allocation->x, allocation->y,
-                                  allocation->width, allocation->height);
-        }
+      gdk_window_move_resize (GTK3_CURVE (widget)->priv->event_window,
+                              allocation->x, allocation->y,
+                              allocation->width, allocation->height);
 
-      gtk3_curve_configure (GTK3_CURVE (widget));
+      if (resized)
+        gtk3_curve_make_pixmap (GTK3_CURVE (widget));
     }
   DEBUG_INFO("size_allocate [E]\n");
 }
 
 static void
-gtk3_curve_configure (Gtk3Curve *curve)
+gtk3_curve_make_pixmap (Gtk3Curve *curve)
 {
+  GtkWidget *widget = GTK_WIDGET (curve);
+  Gtk3CurvePrivate *priv = curve->priv;
   GtkAllocation allocation;
-  GtkWidget *widget;
-  GdkEvent *event = gdk_event_new (GDK_CONFIGURE);
 
-  DEBUG_INFO("configure [S]\n");
-
-  widget = GTK_WIDGET (curve);
   gtk_widget_get_allocation (widget, &allocation);
 
-  DEBUG_INFO("allocation [%d,%d] [%dx%d]\n",
-             allocation.x,
-             allocation.y,
-             allocation.width,
-             allocation.height);
-
-  event->configure.window = g_object_ref (gtk_widget_get_window (widget));
-  event->configure.send_event = TRUE;
-  event->configure.x = allocation.x;
-  event->configure.y = allocation.y;
-  event->configure.width = allocation.width;
-  event->configure.height = allocation.height;
-
-  gtk_widget_event (widget, event);
-  gtk_widget_queue_draw (widget);
+  if (priv->backing_store)
+    cairo_surface_destroy (priv->backing_store);
 
-  gdk_event_free (event);
-
-  DEBUG_INFO("configure [E]\n");
-}
+  priv->backing_store =
+    gdk_window_create_similar_surface (gtk_widget_get_window (widget),
+                                       CAIRO_CONTENT_COLOR_ALPHA,
+                                       allocation.width,
+                                       allocation.height);
 
-static void gtk3_curve_draw_line (cairo_t   *cr,
-                                  gdouble x1, gdouble y1,
-                                  gdouble x2, gdouble y2)
-{
-  cairo_move_to (cr, x1, y1);
-  cairo_line_to (cr, x2, y2);
-  cairo_stroke (cr);
+  priv->backing_store_valid = FALSE;
 }
 
-static gboolean
-gtk3_curve_draw (GtkWidget *widget,
-                 cairo_t   *cr)
+/* Renders the background and the grid into the backing store. */
+static void
+gtk3_curve_draw_background (Gtk3Curve *curve)
 {
-  Gtk3CurvePrivate *priv;
+  GtkWidget        *widget = GTK_WIDGET (curve);
+  Gtk3CurvePrivate *priv = curve->priv;
   GtkStyleContext  *style_context;
-  GtkStyle         *style;
   GdkRGBA           color;
-  gint              last_x, last_y;
-  gint              i;
   GtkAllocation     allocation;
-  Gtk3Curve        *curve;
-  gfloat            grid;
-
-  curve = GTK3_CURVE (widget);
-  priv = curve->priv;
-
-  DEBUG_INFO("draw [S]\n");
+  cairo_t          *cr;
+  gfloat            grid, wm, hm;
+  gint              i;
 
-  if (!cr)
-    {
-      DEBUG_ERROR("cairo == null\n");
-      return TRUE;
-    }
+  if (priv->backing_store == NULL)
+    gtk3_curve_make_pixmap (curve);
 
   gtk_widget_get_allocation (widget, &allocation);
 
-  DEBUG_INFO("%d x %d\n", allocation.width, allocation.height);
+  cr = cairo_create (priv->backing_store);
 
-  if (priv->height != allocation.width ||
-      priv->curve_data.n_points != allocation.height)
-    {
-      gtk3_curve_interpolate (widget,
-                              allocation.width - RADIUS * 2,
-                              allocation.height - RADIUS * 2);
-    }
+  cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+  cairo_paint (cr);
+  cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
 
   if (priv->use_bg_theme)
     {
-      style_context = gtk_widget_get_style_context(GTK_WIDGET (curve));
+      style_context = gtk_widget_get_style_context (widget);
       gtk_render_background(style_context, cr,
                             0, 0,
                             allocation.width + RADIUS * 2,
@@ -618,82 +755,133 @@ gtk3_curve_draw (GtkWidget *widget,
         grid = 2.0;
     }
 
-  gfloat wm = allocation.width - (RADIUS * 2);
-  gfloat hm = allocation.height - (RADIUS * 2);
+  wm = allocation.width - (RADIUS * 2);
+  hm = allocation.height - (RADIUS * 2);
 
-  /* Draw grid */
+  /* Draw grid, all lines in one stroke */
   for (i = 0; i < (int)grid+1; i++)
     {
+      cairo_move_to (cr, RADIUS, i * (hm / grid) + RADIUS);
+      cairo_line_to (cr, wm + RADIUS, i * (hm / grid) + RADIUS);
+
+      cairo_move_to (cr, i * (wm / grid) + RADIUS, RADIUS);
+      cairo_line_to (cr, i * (wm / grid) + RADIUS, hm + RADIUS);
+    }
+  cairo_set_line_width (cr, 0.5);
+  cairo_set_source_rgba (cr,
+                         priv->grid.red,
+                         priv->grid.green,
+                         priv->grid.blue,
+                         priv->grid.alpha);
+  cairo_stroke (cr);
+
+  cairo_destroy (cr);
+
+  priv->backing_store_valid = TRUE;
+}
+
+static gboolean
+gtk3_curve_draw (GtkWidget *widget,
+                 cairo_t   *cr)
+{
+  Gtk3CurvePrivate *priv;
+  GtkStyle         *style;
+  gint              i, first, last;
+  GtkAllocation     allocation;
+  GdkRectangle      clip;
+  Gtk3Curve        *curve;
+
+  curve = GTK3_CURVE (widget);
+  priv = curve->priv;
+
+  DEBUG_INFO("draw [S]\n");
+
+  if (!cr)
+    {
+      DEBUG_ERROR("cairo == null\n");
+      return TRUE;
+    }
+
+  gtk_widget_get_allocation (widget, &allocation);
+
+  DEBUG_INFO("%d x %d\n", allocation.width, allocation.height);
+
+  if (priv->dirty & (DIRTY_GEOMETRY | DIRTY_POINTS))
+    {
+      /* whatever this changes is redrawn in full, see gtk3_curve_invalidate */
+      gtk3_curve_interpolate (widget,
+                              allocation.width - RADIUS * 2,
+                              allocation.height - RADIUS * 2);
+      cairo_region_destroy (priv->damage);
+      priv->damage = cairo_region_create ();
+    }
+
+  if (!gdk_cairo_get_clip_rectangle (cr, &clip))
+    {
+      DEBUG_INFO("draw [E] nothing to draw\n");
+      return FALSE;
+    }
+  DEBUG_INFO("clip [%d,%d] [%dx%d]\n", clip.x, clip.y, clip.width, clip.height);
+
+  if (priv->dirty & DIRTY_STYLE)
+    priv->backing_store_valid = FALSE;
+
+  if (!priv->backing_store_valid)
+    gtk3_curve_draw_background (curve);
+
+  cairo_set_source_surface (cr, priv->backing_store, 0, 0);
+  cairo_paint (cr);
+
+  cairo_set_line_cap (cr, CAIRO_LINE_CAP_ROUND);
+
+  /* Draw a curve or line or set of lines, as a single stroke, leaving out
+   * the segments that do not reach into the clip */
+  if (priv->n_path > 1)
+    {
+      first = path_find (priv->path, priv->n_path, clip.x - 1);
+      last = path_find (priv->path, priv->n_path, clip.x + clip.width + 1);
+      last = MIN (last + 1, priv->n_path - 1);
+
+      cairo_move_to (cr, priv->path[first].x, priv->path[first].y);
+      for (i = first + 1; i <= last; i++)
+        cairo_line_to (cr, priv->path[i].x, priv->path[i].y);
+
       cairo_set_line_width (cr, 0.5);
       cairo_set_source_rgba (cr,
-                             priv->grid.red,
-                             priv->grid.green,
-                             priv->grid.blue,
-                             priv->grid.alpha);
-      gdouble x1 = RADIUS;
-      gdouble y1 = i * (hm / grid) + RADIUS;
-      gdouble x2 = wm + RADIUS;
-      gdouble y2 = i * (hm / grid) + RADIUS;
-      gtk3_curve_draw_line (cr, x1, y1, x2, y2);
-
-      x1 = i * (wm / grid) + RADIUS;
-      y1 = RADIUS;
-      x2 = i * (wm / grid) + RADIUS;
-      y2 = hm + RADIUS;
-      gtk3_curve_draw_line (cr, x1, y1, x2, y2);
-    }
-
-  /* Draw a curve or line or set of lines */
-  for (int i=0; i<priv->curve_data.n_points; i++)
-    {
-      gdouble x = priv->curve_data.d_point[i].x;
-      gdouble y = priv->curve_data.d_point[i].y;
-
-      if (i > 0)
-        {
-          cairo_set_line_width (cr, 0.5);
-          cairo_set_source_rgba (cr,
-                                 priv->curve.red,
-                                 priv->curve.green,
-                                 priv->curve.blue,
-                                 priv->curve.alpha);
-          gtk3_curve_draw_line (cr, last_x, last_y, x, y);
-        }
-
-      last_x = x;
-      last_y = y;
+                             priv->curve.red,
+                             priv->curve.green,
+                             priv->curve.blue,
+                             priv->curve.alpha);
+      cairo_stroke (cr);
     }
 
-  if (priv->curve_data.curve_type != GTK3_CURVE_TYPE_FREE)
-    for (i = 0; i < priv->curve_data.n_cpoints; ++i)
-      {
-        gdouble x, y;
+  for (i = 0; i < priv->n_bullets; ++i)
+    {
+      gdouble x, y;
 
-        if (priv->curve_data.d_cpoints[i].x < priv->min_x)
-          continue;
+      x = priv->bullets[i].x;
+      y = priv->bullets[i].y;
 
-        x = project (priv->curve_data.d_cpoints[i].x,
-                     priv->min_x, priv->max_x,
-                     wm);
-        y = allocation.height - project (priv->curve_data.d_cpoints[i].y,
-                                         priv->min_y,
-                                         priv->max_y,
-                                         hm);
-
-        /* draw a bullet */
-        cairo_set_source_rgba (cr,
-                               priv->cpoint.red,
-                               priv->cpoint.green,
-                               priv->cpoint.blue,
-                               priv->cpoint.alpha);
-        cairo_arc(cr,
-                  x,
-                  y,
-                  RADIUS * 1.5,
-                  0,
-                  2 * M_PI);
-        cairo_fill (cr);
-      }
+      if (x + BULLET_EXTENT < clip.x || x - BULLET_EXTENT > clip.x + clip.width
+          || y + BULLET_EXTENT < clip.y || y - BULLET_EXTENT > clip.y + clip.height)
+        continue;
+
+      /* draw a bullet */
+      cairo_set_source_rgba (cr,
+                             priv->cpoint.red,
+                             priv->cpoint.green,
+                             priv->cpoint.blue,
+                             priv->cpoint.alpha);
+      cairo_arc(cr,
+                x,
+                y,
+                RADIUS * 1.5,
+                0,
+                2 * M_PI);
+      cairo_fill (cr);
+    }
+
+  priv->dirty &= ~DIRTY_STYLE;
 
   DEBUG_INFO("draw [E]\n");
   return FALSE;
@@ -763,20 +951,50 @@ gtk3_curve_leave (GtkWidget        *widget,
   return FALSE;
 }
 
+/* Pointer position of a button or motion event.  The widget gets them on
+ * its own window, so the event coordinates are widget coordinates and
+ * there is no need to ask the server where the pointer is. */
 static
-void gtk3_curve_get_cursor_coord(GtkWidget *widget, gint *tx, gint *ty)
+void gtk3_curve_get_cursor_coord(GtkWidget *widget, GdkEvent *event,
+                                 gint *tx, gint *ty)
 {
-  GdkSeat            *user_seat;
-  GdkDevice        *device_pointer;
-  GdkDisplay       *display;
+  gdouble x, y;
+
+  if (!gdk_event_get_coords (event, &x, &y))
+    {
+      DEBUG_ERROR("event without coordinates\n");
+      x = y = 0.0;
+    }
+
+  *tx = floor (x);
+  *ty = floor (y);
+}
+
+/* Cursors are made once per display and shared by all the curves on it. */
+static GdkCursor *
+gtk3_curve_get_cursor (GtkWidget *widget, GdkCursorType type)
+{
+  GdkDisplay *display;
+  GHashTable *cursors;
+  GdkCursor  *cursor;
 
-  /*  get the pointer position  */
   display = gtk_widget_get_display (widget);
-  user_seat = gdk_display_get_default_seat (gdk_display_get_default ());
- device_pointer = gdk_seat_get_pointer (user_seat);
-  gdk_window_get_device_position (gtk_widget_get_window (widget),
-                                  device_pointer,
-                                  tx, ty, NULL);
+  cursors = g_object_get_data (G_OBJECT (display), "_Gtk3CurveCursors");
+  if (cursors == NULL)
+    {
+      cursors = g_hash_table_new_full (NULL, NULL, NULL, g_object_unref);
+      g_object_set_data_full (G_OBJECT (display), "_Gtk3CurveCursors",
+                              cursors, (GDestroyNotify) g_hash_table_unref);
+    }
+
+  cursor = g_hash_table_lookup (cursors, GINT_TO_POINTER (type));
+  if (cursor == NULL)
+    {
+      cursor = gdk_cursor_new_for_display (display, type);
+      g_hash_table_insert (cursors, GINT_TO_POINTER (type), cursor);
+    }
+
+  return cursor;
 }
 
 static gboolean
@@ -786,14 +1004,15 @@ gtk3_curve_button_press (GtkWidget        *widget,
   Gtk3CurvePrivate *priv = GTK3_CURVE (widget)->priv;
   GdkCursorType     new_type = priv->cursor_type;
   GtkAllocation     allocation;
-  gint              cx, x, y, width, height, i;
-  gint              closest_point = 0;
-  gfloat            rx, ry, min_x;
+  gint              x, y, width, height;
+  gint              closest_point, insert;
+  gfloat            rx, ry, min_x, max_x, min_y, max_y;
   gint              tx, ty;
-  guint             distance;
 
   DEBUG_INFO("button press [S]\n");
 
+  gtk3_curve_flush_motion (widget);
+
   gtk_grab_add (widget);
   new_type = GDK_TCROSS;
 
@@ -806,7 +1025,7 @@ gtk3_curve_button_press (GtkWidget        *widget,
     return FALSE;
 
   /*  get the pointer position  */
-  gtk3_curve_get_cursor_coord (widget, &tx, &ty);
+  gtk3_curve_get_cursor_coord (widget, (GdkEvent *) event, &tx, &ty);
   x = CLAMP ((tx - RADIUS), 0, width - 1);
   y = CLAMP ((ty - RADIUS), 0, height - 1);
 
@@ -814,62 +1033,31 @@ gtk3_curve_button_press (GtkWidget        *widget,
               x, y,
               tx, ty);
 
-  min_x = priv->min_x;
-
-  distance = ~0U;
-  for (i = 0; i < priv->curve_data.n_cpoints; ++i)
-    {
-      cx = project (priv->curve_data.d_cpoints[i].x, min_x, priv->max_x, width);
-      if ((guint) abs (x - cx) < distance)
-        {
-          distance = abs (x - cx);
-          closest_point = i;
-        }
-    }
+  gtk3_curve_model_get_range (priv->model, &min_x, &max_x, &min_y, &max_y);
+  rx = unproject (x, min_x, max_x, width);
+  ry = unproject (height - y, min_y, max_y, height);
 
-  switch (priv->curve_data.curve_type)
+  if (gtk3_curve_has_points (GTK3_CURVE (widget)))
     {
-    default:
-    case GTK3_CURVE_TYPE_LINEAR:
-    case GTK3_CURVE_TYPE_SPLINE:
-      if (distance > MIN_DISTANCE)
+      closest_point = gtk3_curve_find_point (GTK3_CURVE (widget), x, y, &insert);
+      if (closest_point < 0)
         {
           /* insert a new control point */
-          if (priv->curve_data.n_cpoints > 0)
-            {
-              cx = project (priv->curve_data.d_cpoints[closest_point].x, min_x,
-                            priv->max_x, width);
-              if (x > cx)
-                ++closest_point;
-            }
-          ++priv->curve_data.n_cpoints;
-          priv->curve_data.d_cpoints =
-            g_realloc (priv->curve_data.d_cpoints,
-                       priv->curve_data.n_cpoints * sizeof (*priv->curve_data.d_cpoints));
-          for (i = priv->curve_data.n_cpoints - 1; i > closest_point; --i)
-            memcpy (priv->curve_data.d_cpoints + i, priv->curve_data.d_cpoints + i - 1,
-                    sizeof (*priv->curve_data.d_cpoints));
+          closest_point = insert;
+          gtk3_curve_model_insert_point (priv->model, closest_point, rx, ry);
         }
+      else
+        gtk3_curve_model_set_point (priv->model, closest_point, rx, ry);
       priv->grab_point = closest_point;
-      priv->curve_data.d_cpoints[priv->grab_point].x =
-        unproject (x, min_x, priv->max_x, width);
-      priv->curve_data.d_cpoints[priv->grab_point].y =
-        unproject (height - y, priv->min_y, priv->max_y, height);
-      gtk3_curve_interpolate (widget, width, height);
-      break;
-
-    case GTK3_CURVE_TYPE_FREE:
-      priv->curve_data.d_point[x].x = RADIUS + x;
-      priv->curve_data.d_point[x].y = RADIUS + y;
-      priv->grab_point = x;
-      priv->last = y;
-      break;
     }
-
-  if (gtk_widget_is_visible (widget))
+  else
     {
-      DEBUG_INFO("queue draw\n");
-      gtk_widget_queue_draw (widget);
+      /* drawing on an analytic curve makes it free form */
+      if (gtk3_curve_model_get_curve_type (priv->model) != GTK3_CURVE_TYPE_FREE)
+        gtk3_curve_model_set_curve_type (priv->model, GTK3_CURVE_TYPE_FREE);
+      gtk3_curve_model_set_free_segment (priv->model, rx, ry, rx, ry);
+      priv->grab_point = x;
+      priv->last = y;
     }
 
   DEBUG_INFO("button press [E]\n");
@@ -884,11 +1072,7 @@ gtk3_curve_button_release (GtkWidget        *widget,
   Gtk3CurvePrivate *priv = GTK3_CURVE (widget)->priv;
   GtkAllocation     allocation;
   GdkCursorType     new_type = priv->cursor_type;
-  gint              src, dst, cx, x, y, width, height, i;
-  gfloat            rx, ry, min_x;
-  gint              closest_point = 0;
-  guint             distance;
-  gint              tx, ty;
+  gint              width, height;
 
   DEBUG_INFO("button release [S]\n");
 
@@ -902,66 +1086,31 @@ gtk3_curve_button_release (GtkWidget        *widget,
   if ((width < 0) || (height < 0))
     return FALSE;
 
-  /*  get the pointer position  */
-  gtk3_curve_get_cursor_coord (widget, &tx, &ty);
-  x = CLAMP ((tx - RADIUS), 0, width - 1);
-  y = CLAMP ((ty - RADIUS), 0, height - 1);
-
-  DEBUG_INFO("release : xy[%dx%d] txy[%dx%d]\n",
-              x, y,
-              tx, ty);
-
-  min_x = priv->min_x;
-
-  distance = ~0U;
-  for (i = 0; i < priv->curve_data.n_cpoints; ++i)
+  /* the drag ends exactly where the button went up, not where the last
+   * frame left it */
+  if (priv->motion_pending)
     {
-      cx = project (priv->curve_data.d_cpoints[i].x,
-                    min_x, priv->max_x, width);
-      if ((guint) abs (x - cx) < distance)
-        {
-          distance = abs (x - cx);
-          closest_point = i;
-        }
+      gtk3_curve_get_cursor_coord (widget, (GdkEvent *) event,
+                                   &priv->motion_x, &priv->motion_y);
+      priv->motion_state = event->state;
+      gtk3_curve_flush_motion (widget);
     }
-
-  /* delete inactive points: */
-  if (priv->curve_data.curve_type != GTK3_CURVE_TYPE_FREE)
+  if (priv->tick_id)
     {
-      for (src = dst = 0; src < priv->curve_data.n_cpoints; ++src)
-        {
-          if (priv->curve_data.d_cpoints[src].x >= min_x)
-            {
-              memcpy (priv->curve_data.d_cpoints + dst,
-                      priv->curve_data.d_cpoints + src,
-                      sizeof (*priv->curve_data.d_cpoints));
-              ++dst;
-            }
-        }
-
-      if (dst < src)
-        {
-          priv->curve_data.n_cpoints -= (src - dst);
+      gtk_widget_remove_tick_callback (widget, priv->tick_id);
+      priv->tick_id = 0;
+    }
 
-          if (priv->curve_data.n_cpoints <= 0)
-            {
-              priv->curve_data.n_cpoints = 1;
-              priv->curve_data.d_cpoints[0].x = min_x;
-              priv->curve_data.d_cpoints[0].y = priv->min_y;
-              gtk3_curve_interpolate (widget, width, height);
-
-              if (gtk_widget_is_visible (widget))
-                {
-                  DEBUG_INFO("queue draw\n");
-                  gtk_widget_queue_draw (widget);
-                }
-            }
+  /* delete inactive points: */
+  if (gtk3_curve_has_points (GTK3_CURVE (widget)))
+    gtk3_curve_model_remove_inactive_points (priv->model);
 
-          priv->curve_data.d_cpoints =
-            g_realloc (priv->curve_data.d_cpoints,
-                       priv->curve_data.n_cpoints *
-                         sizeof (*priv->curve_data.d_cpoints));
-        }
+  /* catch up on what the local updates left out during the drag */
+  if (priv->stale > 0.0)
+    {
+      priv->revision = 0;
+      gtk3_curve_interpolate (widget, width, height);
+      gtk3_curve_queue_damage (GTK3_CURVE (widget));
     }
 
   new_type = GDK_FLEUR;
@@ -972,26 +1121,77 @@ gtk3_curve_button_release (GtkWidget        *widget,
   return FALSE;
 }
 
+/* Only records the pointer state; it is applied by the next frame's
+ * gtk3_curve_tick, so however many events arrive in between cost one
+ * update. */
 static gboolean
 gtk3_curve_motion_notify (GtkWidget        *widget,
                           GdkEventMotion   *event)
 {
   Gtk3CurvePrivate *priv = GTK3_CURVE (widget)->priv;
-  GtkAllocation     allocation;
-  GdkCursorType     new_type = priv->cursor_type;
-  gint              i, src, dst, leftbound, rightbound;
-  GdkEventMotion   *mevent;
-  gint              tx, ty, h,w;
-  gint              cx, x, y, width, height;
-  gint              closest_point = 0;
-  gfloat            rx, ry, min_x;
-  guint             distance;
-  gint              x1, x2, y1, y2;
-  gint              retval = FALSE;
 
   DEBUG_INFO("motion_notify [S]\n");
-  mevent = (GdkEventMotion *) event;
 
+  /*  get the pointer position  */
+  gtk3_curve_get_cursor_coord (widget, (GdkEvent *) event,
+                               &priv->motion_x, &priv->motion_y);
+  priv->motion_state = event->state;
+  priv->motion_pending = TRUE;
+
+  /* with GDK_POINTER_MOTION_HINT_MASK, ask for the next one */
+  gdk_event_request_motions (event);
+
+  if (priv->tick_id == 0)
+    priv->tick_id = gtk_widget_add_tick_callback (widget, gtk3_curve_tick,
+                                                  NULL, NULL);
+
+  DEBUG_INFO("motion_notify [E]\n");
+
+  return FALSE;
+}
+
+static gboolean
+gtk3_curve_tick (GtkWidget     *widget,
+                 GdkFrameClock *frame_clock,
+                 gpointer       user_data)
+{
+  Gtk3CurvePrivate *priv = GTK3_CURVE (widget)->priv;
+
+  priv->tick_id = 0;
+  gtk3_curve_flush_motion (widget);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Applies the pointer state recorded by the last motion event, if it has
+ * not been yet. */
+static void
+gtk3_curve_flush_motion (GtkWidget *widget)
+{
+  Gtk3CurvePrivate *priv = GTK3_CURVE (widget)->priv;
+
+  if (!priv->motion_pending)
+    return;
+
+  priv->motion_pending = FALSE;
+  gtk3_curve_apply_motion (widget, priv->motion_x, priv->motion_y,
+                           priv->motion_state);
+}
+
+static void
+gtk3_curve_apply_motion (GtkWidget       *widget,
+                         gint             tx,
+                         gint             ty,
+                         GdkModifierType  state)
+{
+  Gtk3CurvePrivate *priv = GTK3_CURVE (widget)->priv;
+  GtkAllocation     allocation;
+  GdkCursorType     new_type = priv->cursor_type;
+  gint              leftbound, rightbound;
+  gint              x, y, width, height;
+  gfloat            rx, ry, px, py, min_x, max_x, min_y, max_y;
+
+  DEBUG_INFO("apply motion [S]\n");
 
   gtk_widget_get_allocation (widget, &allocation);
 
@@ -999,10 +1199,8 @@ gtk3_curve_motion_notify (GtkWidget        *widget,
   height = allocation.height - RADIUS * 2;
 
   if ((width < 0) || (height < 0))
-    return FALSE;
+    return;
 
-  /*  get the pointer position  */
-  gtk3_curve_get_cursor_coord (widget, &tx, &ty);
   x = CLAMP ((tx - RADIUS), 0, width - 1);
   y = CLAMP ((ty - RADIUS), 0, height - 1);
 
@@ -1010,28 +1208,14 @@ gtk3_curve_motion_notify (GtkWidget        *widget,
               x, y,
               tx, ty);
 
-  min_x = priv->min_x;
-
-  distance = ~0U;
-  for (i = 0; i < priv->curve_data.n_cpoints; ++i)
-    {
-      cx = project (priv->curve_data.d_cpoints[i].x, min_x, priv->max_x, width);
-      if ((guint) abs (x - cx) < distance)
-        {
-          distance = abs (x - cx);
-          closest_point = i;
-        }
-    }
+  gtk3_curve_model_get_range (priv->model, &min_x, &max_x, &min_y, &max_y);
 
-  switch (priv->curve_data.curve_type)
+  if (gtk3_curve_has_points (GTK3_CURVE (widget)))
     {
-    default:
-    case GTK3_CURVE_TYPE_LINEAR:
-    case GTK3_CURVE_TYPE_SPLINE:
       if (priv->grab_point == -1)
         {
           /* if no point is grabbed...  */
-          if (distance <= MIN_DISTANCE)
+          if (gtk3_curve_find_point (GTK3_CURVE (widget), x, y, NULL) >= 0)
             new_type = GDK_FLEUR;
           else
             new_type = GDK_TCROSS;
@@ -1042,97 +1226,60 @@ gtk3_curve_motion_notify (GtkWidget        *widget,
           new_type = GDK_TCROSS;
 
           leftbound = -MIN_DISTANCE;
-          if (priv->grab_point > 0)
-            leftbound = project (priv->curve_data.d_cpoints[priv->grab_point - 1].x,
-                                 min_x, priv->max_x, width);
+          if (gtk3_curve_model_get_point (priv->model, priv->grab_point - 1,
+                                          &px, NULL))
+            leftbound = project (px, min_x, max_x, width);
 
           rightbound = width + RADIUS * 2 + MIN_DISTANCE;
-          if (priv->grab_point + 1 < priv->curve_data.n_cpoints)
-            rightbound = project (priv->curve_data.d_cpoints[priv->grab_point + 1].x,
-                                  min_x, priv->max_x, width);
+          if (gtk3_curve_model_get_point (priv->model, priv->grab_point + 1,
+                                          &px, NULL))
+            rightbound = project (px, min_x, max_x, width);
 
           if (tx <= leftbound || tx >= rightbound
               || ty > height + RADIUS * 2 + MIN_DISTANCE
               || ty < -MIN_DISTANCE)
-            priv->curve_data.d_cpoints[priv->grab_point].x = min_x - 1.0;
-          else
             {
-              rx = unproject (x, min_x, priv->max_x, width);
-              ry = unproject (height - y, priv->min_y, priv->max_y, height);
-              priv->curve_data.d_cpoints[priv->grab_point].x = rx;
-              priv->curve_data.d_cpoints[priv->grab_point].y = ry;
+              gtk3_curve_model_get_point (priv->model, priv->grab_point,
+                                          NULL, &py);
+              gtk3_curve_model_set_point (priv->model, priv->grab_point,
+                                          min_x - 1.0, py);
             }
-          gtk3_curve_interpolate (widget, width, height);
-          if (gtk_widget_is_visible (widget))
+          else
             {
-              DEBUG_INFO("queue draw\n");
-              gtk_widget_queue_draw (widget);
+              rx = unproject (x, min_x, max_x, width);
+              ry = unproject (height - y, min_y, max_y, height);
+              gtk3_curve_model_set_point (priv->model, priv->grab_point,
+                                          rx, ry);
             }
         }
-      break;
-
-    case GTK3_CURVE_TYPE_FREE:
+    }
+  else
+    {
       if (priv->grab_point != -1)
         {
-          if (priv->grab_point > x)
-            {
-              x1 = x;
-              x2 = priv->grab_point;
-              y1 = y;
-              y2 = priv->last;
-            }
-          else
-            {
-              x1 = priv->grab_point;
-              x2 = x;
-              y1 = priv->last;
-              y2 = y;
-            }
-
-          if (x2 != x1)
-            for (i = x1; i <= x2; i++)
-              {
-                priv->curve_data.d_point[i].x = RADIUS + i;
-                priv->curve_data.d_point[i].y = RADIUS +
-                                   (y1 + ((y2 - y1) * (i - x1)) / (x2 - x1));
-              }
-          else
-            {
-              priv->curve_data.d_point[x].x = RADIUS + x;
-              priv->curve_data.d_point[x].y = RADIUS + y;
-            }
+          gtk3_curve_model_set_free_segment (priv->model,
+              unproject (priv->grab_point, min_x, max_x, width),
+              unproject (height - priv->last, min_y, max_y, height),
+              unproject (x, min_x, max_x, width),
+              unproject (height - y, min_y, max_y, height));
           priv->grab_point = x;
           priv->last = y;
-          if (gtk_widget_is_visible (widget))
-            {
-              DEBUG_INFO("queue draw\n");
-              gtk_widget_queue_draw (widget);
-            }
         }
-      if (mevent->state & GDK_BUTTON1_MASK)
+      if (state & GDK_BUTTON1_MASK)
         new_type = GDK_TCROSS;
       else
         new_type = GDK_PENCIL;
-      break;
     }
 
   if (new_type != (GdkCursorType) priv->cursor_type)
     {
-      GdkCursor *cursor;
       priv->cursor_type = new_type;
-      cursor = gdk_cursor_new_for_display (gtk_widget_get_display (widget),
-                                           priv->cursor_type);
-      gdk_window_set_cursor (gtk_widget_get_window (widget), cursor);
-      g_object_unref (cursor);
-    }
-
-  if (gtk_widget_is_visible (widget))
-    {
-      DEBUG_INFO("queue draw\n");
-      gtk_widget_queue_draw (widget);
+      gdk_window_set_cursor (priv->event_window,
+                             gtk3_curve_get_cursor (widget,
+                                                    priv->cursor_type));
     }
 
-  DEBUG_INFO("motion_notify [E]\n");
+  DEBUG_INFO("apply motion [E]\n");
 }
 
 static void
@@ -1148,6 +1295,22 @@ static void
 gtk3_curve_dispose (GObject *object)
 {
   Gtk3CurvePrivate *priv = GTK3_CURVE (object)->priv;
+
+  if (priv->frozen_model)
+    {
+      gtk3_curve_model_end_update (priv->frozen_model);
+      g_object_unref (priv->frozen_model);
+      priv->frozen_model = NULL;
+    }
+
+  if (priv->model)
+    {
+      g_signal_handler_disconnect (priv->model, priv->model_changed_id);
+      g_signal_handler_disconnect (priv->model, priv->model_notify_id);
+      g_object_unref (priv->model);
+      priv->model = NULL;
+    }
+
   G_OBJECT_CLASS (gtk3_curve_parent_class)->dispose (object);
 }
 
@@ -1164,8 +1327,11 @@ gtk3_curve_finalize (GObject *object)
 
   if (priv->curve_data.d_point)
     g_free (priv->curve_data.d_point);
-  if (priv->curve_data.d_cpoints)
-    g_free (priv->curve_data.d_cpoints);
+  g_free (priv->vector);
+  g_free (priv->path);
+  g_free (priv->bullets);
+  g_free (priv->bullet_index);
+  cairo_region_destroy (priv->damage);
 
   G_OBJECT_CLASS (gtk3_curve_parent_class)->finalize (object);
 }
@@ -1187,23 +1353,20 @@ gtk3_curve_set_property (GObject              *object,
       break;
 
     case PROP_MIN_X:
-      gtk3_curve_set_range (widget, g_value_get_float (value), priv->max_x,
-                            priv->min_y, priv->max_y);
-      break;
-
     case PROP_MAX_X:
-      gtk3_curve_set_range (widget, priv->min_x, g_value_get_float (value),
-                            priv->min_y, priv->max_y);
-      break;
-
     case PROP_MIN_Y:
-      gtk3_curve_set_range (widget, priv->min_x, priv->max_x,
-                            g_value_get_float (value), priv->max_y);
+    case PROP_MAX_Y:
+      /* kept until all properties of the g_object_set are set, so
+       * setting the whole range resizes and resets the curve once; in
+       * an update that already happens once at its end */
+      priv->range_set[prop_id - PROP_MIN_X] = g_value_get_float (value);
+      priv->range_set_mask |= 1 << (prop_id - PROP_MIN_X);
+      if (priv->freeze_count > 0)
+        gtk3_curve_apply_range_set (curve);
       break;
 
-    case PROP_MAX_Y:
-      gtk3_curve_set_range (widget, priv->min_x, priv->max_x,
-                            priv->min_y, g_value_get_float (value));
+    case PROP_MODEL:
+      gtk3_curve_set_model (widget, g_value_get_object (value));
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -1219,27 +1382,24 @@ gtk3_curve_get_property (GObject              *object,
 {
   Gtk3Curve *curve = GTK3_CURVE (object);
   Gtk3CurvePrivate *priv = curve->priv;
+  gfloat range[4];
 
   switch (prop_id)
     {
     case PROP_CURVE_TYPE:
-      g_value_set_enum (value, priv->curve_data.curve_type);
+      g_value_set_enum (value, gtk3_curve_model_get_curve_type (priv->model));
       break;
 
     case PROP_MIN_X:
-      g_value_set_float (value, priv->min_x);
-      break;
-
     case PROP_MAX_X:
-      g_value_set_float (value, priv->max_x);
-      break;
-
     case PROP_MIN_Y:
-      g_value_set_float (value, priv->min_y);
+    case PROP_MAX_Y:
+      gtk3_curve_get_range_set (curve, range);
+      g_value_set_float (value, range[prop_id - PROP_MIN_X]);
       break;
 
-    case PROP_MAX_Y:
-      g_value_set_float (value, priv->max_y);
+    case PROP_MODEL:
+      g_value_set_object (value, priv->model);
       break;
 
     default:
@@ -1248,29 +1408,89 @@ gtk3_curve_get_property (GObject              *object,
     }
 }
 
+/* Applies the range properties set since the notifications were last
+ * dispatched, which g_object_set holds back until it has set them all. */
+static void
+gtk3_curve_dispatch_properties_changed (GObject     *object,
+                                        guint        n_pspecs,
+                                        GParamSpec **pspecs)
+{
+  gtk3_curve_apply_range_set (GTK3_CURVE (object));
+
+  G_OBJECT_CLASS (gtk3_curve_parent_class)->dispatch_properties_changed
+    (object, n_pspecs, pspecs);
+}
+
+/* The model range with the range properties not applied yet. */
+static void
+gtk3_curve_get_range_set (Gtk3Curve *curve, gfloat range[4])
+{
+  Gtk3CurvePrivate *priv = curve->priv;
+  gint i;
+
+  gtk3_curve_model_get_range (priv->model,
+                              &range[0], &range[1], &range[2], &range[3]);
+  for (i = 0; i < 4; ++i)
+    if (priv->range_set_mask & (1 << i))
+      range[i] = priv->range_set[i];
+}
+
+static void
+gtk3_curve_apply_range_set (Gtk3Curve *curve)
+{
+  Gtk3CurvePrivate *priv = curve->priv;
+  gfloat range[4];
+
+  if (priv->range_set_mask == 0)
+    return;
+
+  gtk3_curve_get_range_set (curve, range);
+  priv->range_notified = priv->range_set_mask;
+  priv->range_set_mask = 0;
+  gtk3_curve_set_range (GTK_WIDGET (curve),
+                        range[0], range[1], range[2], range[3]);
+  priv->range_notified = 0;
+}
+
 static void
 gtk3_curve_size_graph (Gtk3Curve *curve)
 {
   Gtk3CurvePrivate *priv = curve->priv;
   GdkRectangle geom;
   gint width, height;
-  gfloat aspect;
-  
-  GdkWindow *gdk_window = gtk_widget_get_window(GTK_WIDGET (curve));
-  GdkDisplay *gdk_display = gdk_window_get_display(gdk_window);
-  GdkMonitor *monitor = gdk_display_get_primary_monitor(gdk_display);
-  gdk_monitor_get_geometry(monitor, &geom);
-
-  width  = (priv->max_x - priv->min_x);
-  height = (priv->max_y - priv->min_y);
-  aspect = width / (gfloat) height;
-  if (width > geom.width / 4)
+  gfloat aspect, min_x, max_x, min_y, max_y;
+  GdkDisplay *gdk_display;
+  GdkMonitor *monitor;
+
+  if (priv->freeze_count > 0)
     {
-      width  = geom.width / 4;
+      priv->pending_size = TRUE;
+      return;
     }
-  if (height > geom.height / 4)
+
+  gtk3_curve_model_get_range (priv->model, &min_x, &max_x, &min_y, &max_y);
+
+  width  = (max_x - min_x);
+  height = (max_y - min_y);
+  aspect = width / (gfloat) height;
+
+  /* the widget may not be realized yet, so ask the display rather than
+   * its window, and do not assume there is a primary monitor */
+  gdk_display = gtk_widget_get_display (GTK_WIDGET (curve));
+  monitor = gdk_display ? gdk_display_get_primary_monitor (gdk_display) : NULL;
+  if (monitor == NULL && gdk_display)
+    monitor = gdk_display_get_monitor (gdk_display, 0);
+  if (monitor)
     {
-      height = geom.height / 4;
+      gdk_monitor_get_geometry (monitor, &geom);
+      if (width > geom.width / 4)
+        {
+          width  = geom.width / 4;
+        }
+      if (height > geom.height / 4)
+        {
+          height = geom.height / 4;
+        }
     }
 
   if (aspect < 1.0)
@@ -1297,57 +1517,218 @@ gtk3_curve_create_layouts (GtkWidget *widget)
 }
 
 static void
-gtk3_curve_reset_vector (GtkWidget *widget)
+gtk3_curve_model_changed (Gtk3CurveModel *model, Gtk3Curve *curve)
 {
-  Gtk3Curve *curve = GTK3_CURVE (widget);
   Gtk3CurvePrivate *priv = curve->priv;
+  GtkWidget *widget = GTK_WIDGET (curve);
+  Gtk3CurveType type;
   gint width, height;
 
-  g_free (priv->curve_data.d_cpoints);
+  if (priv->freeze_count > 0)
+    {
+      priv->pending_changed = TRUE;
+      return;
+    }
+  priv->pending_changed = FALSE;
+
+  /* interpolate right away so every edit only redraws what it changed */
+  width = gtk_widget_get_allocated_width (widget) - RADIUS * 2;
+  height = gtk_widget_get_allocated_height (widget) - RADIUS * 2;
+  if (width >= RADIUS * 2 && height >= RADIUS * 2)
+    {
+      gtk3_curve_interpolate (widget, width, height);
+      gtk3_curve_queue_damage (curve);
+    }
+  else
+    gtk3_curve_invalidate (curve, DIRTY_POINTS);
+
+  type = gtk3_curve_model_get_curve_type (model);
+  if (type != priv->curve_type)
+    {
+      priv->curve_type = type;
+      g_signal_emit (curve, curve_type_changed_signal, 0);
+    }
+
+  gtk3_curve_note_change (curve);
+
+  DEBUG_INFO("model changed\n");
+}
+
+/* Adds what changed in the model since the last call to what the next
+ * "changed" reports, and schedules it for the next frame. */
+static void
+gtk3_curve_note_change (Gtk3Curve *curve)
+{
+  Gtk3CurvePrivate *priv = curve->priv;
+  GtkWidget *widget = GTK_WIDGET (curve);
+  gfloat x1, x2;
 
-  priv->curve_data.n_cpoints = 2;
-  priv->curve_data.d_cpoints = g_malloc (2 * sizeof (priv->curve_data.d_cpoints[0]));
-  priv->curve_data.d_cpoints[0].x = priv->min_x;
-  priv->curve_data.d_cpoints[0].y = priv->min_y;
-  priv->curve_data.d_cpoints[1].x = priv->max_x;
-  priv->curve_data.d_cpoints[1].y = priv->max_y;
+  if (!gtk3_curve_model_get_dirty_interval (priv->model,
+                                            priv->changed_revision,
+                                            &x1, &x2))
+    gtk3_curve_model_get_range (priv->model, &x1, &x2, NULL, NULL);
+  priv->changed_revision = gtk3_curve_model_get_revision (priv->model);
 
-  width = gtk_widget_get_allocated_width(widget) - RADIUS * 2;
-  height = gtk_widget_get_allocated_height(widget) - RADIUS * 2;
-  if (width < RADIUS * 2) return;
-  if (height < RADIUS * 2) return;
+  if (x1 > x2)
+    return;
 
-  if (priv->curve_data.curve_type == GTK3_CURVE_TYPE_FREE)
+  if (priv->changed_pending)
     {
-      priv->curve_data.curve_type = GTK3_CURVE_TYPE_LINEAR;
-      gtk3_curve_interpolate (widget, width, height);
-      priv->curve_data.curve_type = GTK3_CURVE_TYPE_FREE;
+      priv->changed_x1 = MIN (priv->changed_x1, x1);
+      priv->changed_x2 = MAX (priv->changed_x2, x2);
     }
   else
-    gtk3_curve_interpolate (widget, width, height);
+    {
+      priv->changed_x1 = x1;
+      priv->changed_x2 = x2;
+      priv->changed_pending = TRUE;
+    }
+
+  /* without a frame clock there is nothing to wait for */
+  if (!gtk_widget_get_realized (widget))
+    gtk3_curve_emit_changed (curve);
+  else if (priv->changed_tick_id == 0)
+    priv->changed_tick_id =
+      gtk_widget_add_tick_callback (widget, gtk3_curve_changed_tick,
+                                    NULL, NULL);
+}
+
+static void
+gtk3_curve_emit_changed (Gtk3Curve *curve)
+{
+  Gtk3CurvePrivate *priv = curve->priv;
+
+  if (!priv->changed_pending)
+    return;
 
-  DEBUG_INFO("reset vector\n");
+  priv->changed_pending = FALSE;
+
+  DEBUG_INFO("changed [%f, %f] revision %u\n",
+             priv->changed_x1, priv->changed_x2, priv->changed_revision);
+
+  g_signal_emit (curve, changed_signal, 0,
+                 priv->changed_x1, priv->changed_x2, priv->changed_revision);
+}
+
+static gboolean
+gtk3_curve_changed_tick (GtkWidget     *widget,
+                         GdkFrameClock *frame_clock,
+                         gpointer       user_data)
+{
+  Gtk3Curve *curve = GTK3_CURVE (widget);
 
-  if (gtk_widget_is_visible (GTK_WIDGET (curve)))
+  curve->priv->changed_tick_id = 0;
+  gtk3_curve_emit_changed (curve);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* forward the model properties the widget mirrors */
+static void
+gtk3_curve_model_notify (Gtk3CurveModel *model,
+                         GParamSpec     *pspec,
+                         Gtk3Curve      *curve)
+{
+  static const gchar *range_names[4] = { "min-x", "max-x", "min-y", "max-y" };
+  GParamSpec *own;
+  gint i;
+
+  own = g_object_class_find_property (G_OBJECT_GET_CLASS (curve), pspec->name);
+  if (own == NULL)
+    return;
+
+  /* range properties being applied were notified when they were set */
+  for (i = 0; i < 4; ++i)
+    if ((curve->priv->range_notified & (1 << i)) &&
+        strcmp (pspec->name, range_names[i]) == 0)
+      return;
+
+  g_object_notify_by_pspec (G_OBJECT (curve), own);
+}
+
+/* Records what changed and schedules a redraw. */
+static void
+gtk3_curve_invalidate (Gtk3Curve *curve, guint dirty)
+{
+  GtkWidget *widget = GTK_WIDGET (curve);
+
+  curve->priv->dirty |= dirty;
+
+  if (curve->priv->freeze_count > 0)
     {
-      DEBUG_INFO("queue draw\n");
-      gtk_widget_queue_draw (GTK_WIDGET (curve));
+      curve->priv->pending_draw = TRUE;
+      return;
+    }
 
+  if (gtk_widget_is_visible (widget))
+    {
+      DEBUG_INFO("queue draw\n");
+      gtk_widget_queue_draw (widget);
     }
 }
 
+/* Schedules a redraw of the damage and clears it. */
+static void
+gtk3_curve_queue_damage (Gtk3Curve *curve)
+{
+  Gtk3CurvePrivate *priv = curve->priv;
+  GtkWidget *widget = GTK_WIDGET (curve);
+  cairo_rectangle_int_t rect;
+  gint i;
+
+  if (gtk_widget_is_visible (widget))
+    for (i = 0; i < cairo_region_num_rectangles (priv->damage); ++i)
+      {
+        cairo_region_get_rectangle (priv->damage, i, &rect);
+        DEBUG_INFO("queue draw [%d,%d] [%dx%d]\n",
+                   rect.x, rect.y, rect.width, rect.height);
+        gtk_widget_queue_draw_area (widget, rect.x, rect.y,
+                                    rect.width, rect.height);
+      }
+
+  cairo_region_destroy (priv->damage);
+  priv->damage = cairo_region_create ();
+}
+
+/* Brings curve_data.d_point up to date.  When the size is unchanged only
+ * the samples the model reports as changed are evaluated again; during a
+ * spline drag the ones left out may lag by up to half a pixel, after that
+ * everything is evaluated again.  What changed on screen is added to the
+ * damage. */
 static void
 gtk3_curve_interpolate (GtkWidget *widget, gint width, gint height)
 {
   Gtk3Curve *curve = GTK3_CURVE (widget);
   Gtk3CurvePrivate *priv = curve->priv;
-  gfloat *vector;
-  int i;
+  cairo_rectangle_int_t rect;
+  gfloat min_y, max_y, budget, error;
+  gint start, end, first, last, top, bottom, i;
+
+  if (width < 2 || height < 0) return;
 
-  if (width < 0 || height < 0) return;
-  vector = g_malloc (width * sizeof (vector[0]));
+  priv->dirty &= ~(DIRTY_GEOMETRY | DIRTY_POINTS);
 
-  gtk3_curve_get_vector (widget, width, vector);
+  gtk3_curve_model_get_range (priv->model, NULL, NULL, &min_y, &max_y);
+
+  start = 0;
+  end = width;
+  if (priv->revision != 0 && height > 1 &&
+      priv->curve_data.n_points == width && priv->height == height)
+    {
+      budget = 0.5 * (max_y - min_y) / (height - 1) - priv->stale;
+      if (gtk3_curve_model_get_dirty_range (priv->model, priv->revision, width,
+                                            MAX (budget, 0.0),
+                                            &start, &end, &error))
+        priv->stale += error;
+      else
+        {
+          start = 0;
+          end = width;
+        }
+    }
+  if (start == 0 && end == width)
+    priv->stale = 0.0;
+  priv->revision = gtk3_curve_model_get_revision (priv->model);
 
   priv->height = height;
   if (priv->curve_data.n_points != width)
@@ -1355,77 +1736,232 @@ gtk3_curve_interpolate (GtkWidget *widget, gint width, gint height)
       priv->curve_data.n_points = width;
       g_free (priv->curve_data.d_point);
       priv->curve_data.d_point = g_malloc (priv->curve_data.n_points * sizeof (priv->curve_data.d_point[0]));
+      g_free (priv->vector);
+      priv->vector = g_malloc (priv->curve_data.n_points * sizeof (priv->vector[0]));
+      g_free (priv->path);
+      priv->path = g_malloc (priv->curve_data.n_points * sizeof (priv->path[0]));
     }
 
-  for (i = 0; i < width; ++i)
+  gtk3_curve_update_bullets (curve, width, height);
+
+  if (start >= end)
+    return;
+
+  DEBUG_INFO("interpolate [%d, %d)\n", start, end);
+
+  /* the path blocks the changed pixels and the segments leading to them
+   * are in, between their old and new extents */
+  first = 0;
+  last = width - 1;
+  top = bottom = 0;
+  if (start != 0 || end != width)
     {
-      priv->curve_data.d_point[i].x = RADIUS + i;
-      priv->curve_data.d_point[i].y = RADIUS + height
-                         - project (vector[i], priv->min_y, priv->max_y, height);
+      first = MAX (start - 1, 0) / PATH_BLOCK * PATH_BLOCK;
+      last = MIN ((end - 1) / PATH_BLOCK * PATH_BLOCK + PATH_BLOCK, width - 1);
+      top = bottom = priv->curve_data.d_point[first].y;
+      for (i = first + 1; i <= last; ++i)
+        {
+          top = MIN (top, priv->curve_data.d_point[i].y);
+          bottom = MAX (bottom, priv->curve_data.d_point[i].y);
+        }
     }
 
-  g_free (vector);
-}
+  gtk3_curve_model_get_vector_range (priv->model, width, start, end,
+                                     priv->vector);
+
+  /* same as project () on every sample; Gtk3CurvePoint is a pair of gint */
+  G_STATIC_ASSERT (sizeof (Gtk3CurvePoint) == 2 * sizeof (gint));
+  gtk3_curve_kernels_get ()->project (priv->vector + start, end - start, min_y,
+                                      (height - 1) / (max_y - min_y),
+                                      RADIUS + start, RADIUS + height,
+                                      (gint *) (priv->curve_data.d_point + start));
 
-/*                          =====================                          */
-/* ===========================   YE OLDE MATH   ========================== */
-/*                          =====================                          */
+  gtk3_curve_update_path (priv);
 
-/* Solve the tridiagonal equation system that determines the second
-   derivatives for the interpolation points.  (Based on Numerical
-   Recipies 2nd Edition.) */
+  if (start == 0 && end == width)
+    {
+      rect.x = 0;
+      rect.y = 0;
+      rect.width = width + RADIUS * 2;
+      rect.height = height + RADIUS * 2;
+    }
+  else
+    {
+      for (i = first; i <= last; ++i)
+        {
+          top = MIN (top, priv->curve_data.d_point[i].y);
+          bottom = MAX (bottom, priv->curve_data.d_point[i].y);
+        }
+      /* one more pixel around for the line width and antialiasing */
+      rect.x = RADIUS + first - 1;
+      rect.y = top - 1;
+      rect.width = last - first + 3;
+      rect.height = bottom - top + 3;
+    }
+  cairo_region_union_rectangle (priv->damage, &rect);
+}
+
+/* Brings priv->bullets up to date and adds the control points that moved,
+ * appeared or went away to the damage. */
 static void
-spline_solve (int n, gfloat x[], gfloat y[], gfloat y2[])
+gtk3_curve_update_bullets (Gtk3Curve *curve, gint width, gint height)
 {
-  gfloat p, sig, *u;
-  gint i, k;
-
-  u = g_malloc ((n - 1) * sizeof (u[0]));
+  Gtk3CurvePrivate *priv = curve->priv;
+  Gtk3CurvePoint *bullets;
+  gint *bullet_index;
+  cairo_rectangle_int_t rect;
+  gfloat min_x, max_x, min_y, max_y, px, py;
+  gint i, n, n_points;
+
+  gtk3_curve_model_get_range (priv->model, &min_x, &max_x, &min_y, &max_y);
+
+  n = 0;
+  n_points = gtk3_curve_model_get_n_points (priv->model);
+  bullets = g_new (Gtk3CurvePoint, MAX (n_points, 1));
+  bullet_index = g_new (gint, MAX (n_points, 1));
+  if (gtk3_curve_has_points (curve))
+    for (i = 0; i < n_points &&
+                gtk3_curve_model_get_point (priv->model, i, &px, &py); ++i)
+      {
+        if (px < min_x)
+          continue;
 
-  y2[0] = u[0] = 0.0; /* set lower boundary condition to "natural" */
+        bullets[n].x = project (px, min_x, max_x, width);
+        bullets[n].y = height + RADIUS * 2 - project (py, min_y, max_y, height);
+        bullet_index[n] = i;
+        ++n;
+      }
 
-  for (i = 1; i < n - 1; ++i)
+  rect.width = rect.height = BULLET_EXTENT * 2 + 1;
+  for (i = 0; i < MAX (n, priv->n_bullets); ++i)
     {
-      sig = (x[i] - x[i - 1]) / (x[i + 1] - x[i - 1]);
-      p = sig * y2[i - 1] + 2.0;
-      y2[i] = (sig - 1.0) / p;
-      u[i] = ((y[i + 1] - y[i])
-              / (x[i + 1] - x[i]) - (y[i] - y[i - 1]) / (x[i] - x[i - 1]));
-      u[i] = (6.0 * u[i] / (x[i + 1] - x[i - 1]) - sig * u[i - 1]) / p;
+      if (i < n && i < priv->n_bullets &&
+          bullets[i].x == priv->bullets[i].x &&
+          bullets[i].y == priv->bullets[i].y)
+        continue;
+
+      if (i < priv->n_bullets)
+        {
+          rect.x = priv->bullets[i].x - BULLET_EXTENT;
+          rect.y = priv->bullets[i].y - BULLET_EXTENT;
+          cairo_region_union_rectangle (priv->damage, &rect);
+        }
+      if (i < n)
+        {
+          rect.x = bullets[i].x - BULLET_EXTENT;
+          rect.y = bullets[i].y - BULLET_EXTENT;
+          cairo_region_union_rectangle (priv->damage, &rect);
+        }
     }
 
-  y2[n - 1] = 0.0;
-  for (k = n - 2; k >= 0; --k)
-    y2[k] = y2[k] * y2[k + 1] + u[k];
+  g_free (priv->bullets);
+  g_free (priv->bullet_index);
+  priv->bullets = bullets;
+  priv->bullet_index = bullet_index;
+  priv->n_bullets = n;
+}
+
+/* Whether the curve type is edited through control points, which are
+ * drawn and hit-tested, rather than drawn freehand. */
+static gboolean
+gtk3_curve_has_points (Gtk3Curve *curve)
+{
+  Gtk3CurveType type;
 
-  g_free (u);
+  type = gtk3_curve_model_get_curve_type (curve->priv->model);
+
+  return (gtk3_curve_interpolator_get (type)->flags &
+          GTK3_CURVE_INTERP_POINTS) != 0;
 }
 
-static gfloat
-spline_eval (int n, gfloat x[], gfloat y[], gfloat y2[], gfloat val)
+/* Returns the model index of the control point nearest to (x, y), in
+ * curve pixels, among those at most MIN_DISTANCE away horizontally, or
+ * -1 if there is none.  If insert is not NULL it is set to the index a
+ * new point at x goes to. */
+static gint
+gtk3_curve_find_point (Gtk3Curve *curve, gint x, gint y, gint *insert)
 {
-  gint k_lo, k_hi, k;
-  gfloat h, b, a;
+  Gtk3CurvePrivate *priv = curve->priv;
+  GtkWidget *widget = GTK_WIDGET (curve);
+  gint lo, hi, mid, i, dx, dy, distance, closest;
+
+  /* a resize or an edit made while too small left the positions stale */
+  if (priv->dirty & (DIRTY_GEOMETRY | DIRTY_POINTS))
+    {
+      gtk3_curve_interpolate (widget,
+                              gtk_widget_get_allocated_width (widget) - RADIUS * 2,
+                              gtk_widget_get_allocated_height (widget) - RADIUS * 2);
+      gtk3_curve_queue_damage (curve);
+    }
 
-  /* do a binary search for the right interval: */
-  k_lo = 0;
-  k_hi = n - 1;
-  while (k_hi - k_lo > 1)
+  /* first point not left of x */
+  lo = 0;
+  hi = priv->n_bullets;
+  while (lo < hi)
     {
-      k = (k_hi + k_lo) / 2;
-      if (x[k] > val)
-        k_hi = k;
+      mid = (lo + hi) / 2;
+      if (priv->bullets[mid].x < x)
+        lo = mid + 1;
       else
-        k_lo = k;
+        hi = mid;
     }
 
-  h = x[k_hi] - x[k_lo];
-  g_assert (h > 0.0);
+  if (insert)
+    {
+      if (lo < priv->n_bullets)
+        *insert = priv->bullet_index[lo];
+      else if (priv->n_bullets > 0)
+        *insert = priv->bullet_index[priv->n_bullets - 1] + 1;
+      else
+        *insert = 0;
+    }
 
-  a = (x[k_hi] - val) / h;
-  b = (val - x[k_lo]) / h;
-  return a*y[k_lo] + b*y[k_hi] +
-         ((a*a*a - a)*y2[k_lo] + (b*b*b - b)*y2[k_hi]) * (h*h)/6.0;
+  /* points stacked above each other are told apart by their distance;
+   * the bullets are at widget y, y is RADIUS above that */
+  closest = -1;
+  distance = G_MAXINT;
+  for (i = lo; i < priv->n_bullets && priv->bullets[i].x - x <= MIN_DISTANCE; ++i)
+    {
+      dx = priv->bullets[i].x - x;
+      dy = priv->bullets[i].y - RADIUS - y;
+      if (dx * dx + dy * dy < distance)
+        {
+          distance = dx * dx + dy * dy;
+          closest = i;
+        }
+    }
+  for (i = lo - 1; i >= 0 && x - priv->bullets[i].x <= MIN_DISTANCE; --i)
+    {
+      dx = priv->bullets[i].x - x;
+      dy = priv->bullets[i].y - RADIUS - y;
+      if (dx * dx + dy * dy < distance)
+        {
+          distance = dx * dx + dy * dy;
+          closest = i;
+        }
+    }
+
+  return closest < 0 ? -1 : priv->bullet_index[closest];
+}
+
+/* Rebuilds priv->path from curve_data.d_point.  The pixels are decimated
+ * in blocks of PATH_BLOCK that share their end points, so an edit leaves
+ * the path outside the blocks it touches as it was. */
+static void
+gtk3_curve_update_path (Gtk3CurvePrivate *priv)
+{
+  gint i, n, width;
+
+  width = priv->curve_data.n_points;
+  priv->n_path = 0;
+  for (i = 0; i < width - 1; i += PATH_BLOCK)
+    {
+      n = MIN (PATH_BLOCK + 1, width - i);
+      if (priv->n_path > 0)
+        --priv->n_path;
+      priv->n_path += decimate (priv->curve_data.d_point + i, n,
+                                PATH_TOLERANCE, priv->path + priv->n_path);
+    }
 }
 
 static int
@@ -1440,49 +1976,145 @@ unproject (gint value, gfloat min, gfloat max, int norm)
   return value / (gfloat) (norm - 1) * (max - min) + min;
 }
 
+/* Copies to path the points of the polyline point[0 .. n - 1], whose x
+   increases, that are needed to keep every dropped point within
+   tolerance pixels (vertically) of the result, and returns their number.
+   Each segment starts at the last kept point and is extended for as long
+   as some slope passes within tolerance of all the points it spans. */
+static gint
+decimate (const Gtk3CurvePoint *point, gint n, gfloat tolerance,
+          Gtk3CurvePoint *path)
+{
+  const Gtk3CurvePoint *anchor;
+  gfloat lo, hi, dx, slope;
+  gint i, n_path;
+
+  if (n <= 2)
+    {
+      memcpy (path, point, n * sizeof (point[0]));
+      return n;
+    }
+
+  n_path = 0;
+  anchor = &point[0];
+  path[n_path++] = *anchor;
+  lo = -G_MAXFLOAT;
+  hi = G_MAXFLOAT;
+
+  for (i = 1; i < n; ++i)
+    {
+      dx = point[i].x - anchor->x;
+      slope = (point[i].y - anchor->y) / dx;
+
+      if (slope < lo || slope > hi)
+        {
+          anchor = &point[i - 1];
+          path[n_path++] = *anchor;
+          dx = point[i].x - anchor->x;
+          lo = -G_MAXFLOAT;
+          hi = G_MAXFLOAT;
+        }
+
+      lo = MAX (lo, (point[i].y - tolerance - anchor->y) / dx);
+      hi = MIN (hi, (point[i].y + tolerance - anchor->y) / dx);
+    }
+
+  path[n_path++] = point[n - 1];
+
+  return n_path;
+}
+
+/* Returns the index of the last point of path[0 .. n - 1], whose x
+   increases, with x not above the given one, or 0 if there is none. */
+static gint
+path_find (const Gtk3CurvePoint *path, gint n, gint x)
+{
+  gint lo, hi, mid;
+
+  lo = 0;
+  hi = n - 1;
+  while (lo < hi)
+    {
+      mid = (lo + hi + 1) / 2;
+      if (path[mid].x <= x)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+
+  return lo;
+}
+
 /*                          =====================                           */
 /* =========================== PUBLIC FUNCTIONS =========================== */
 /*                          =====================                           */
 
 void
-gtk3_curve_set_gamma (GtkWidget *widget, gfloat gamma)
+gtk3_curve_set_model (GtkWidget *widget, Gtk3CurveModel *model)
 {
   Gtk3Curve *curve = GTK3_CURVE (widget);
   Gtk3CurvePrivate *priv = curve->priv;
-  gfloat x, one_over_gamma, height;
-  Gtk3CurveType old_type;
-  gint i;
 
-  if (priv->curve_data.n_points < 2)
-    return;
+  g_return_if_fail (model == NULL || GTK3_IS_CURVE_MODEL (model));
 
-  old_type = priv->curve_data.curve_type;
-  priv->curve_data.curve_type = GTK3_CURVE_TYPE_FREE;
+  if (model != NULL && model == priv->model)
+    return;
 
-  if (gamma <= 0)
-    one_over_gamma = 1.0;
-  else
-    one_over_gamma = 1.0 / gamma;
-  height = priv->height;
-  for (i = 0; i < priv->curve_data.n_points; ++i)
+  if (priv->model)
     {
-      x = (gfloat) i / (priv->curve_data.n_points - 1);
-      priv->curve_data.d_point[i].x = RADIUS + i;
-      priv->curve_data.d_point[i].y =
-        RADIUS + (height * (1.0 - pow (x, one_over_gamma)) + 0.5);
+      g_signal_handler_disconnect (priv->model, priv->model_changed_id);
+      g_signal_handler_disconnect (priv->model, priv->model_notify_id);
+      g_object_unref (priv->model);
     }
 
-  if (old_type != GTK3_CURVE_TYPE_FREE)
-    g_signal_emit (curve, curve_type_changed_signal, 0);
+  if (model)
+    priv->model = g_object_ref (model);
+  else
+    priv->model = gtk3_curve_model_new ();
+  priv->revision = 0;
+  priv->changed_revision = 0;
+
+  priv->model_changed_id =
+    g_signal_connect (priv->model, "changed",
+                      G_CALLBACK (gtk3_curve_model_changed), curve);
+  priv->model_notify_id =
+    g_signal_connect (priv->model, "notify",
+                      G_CALLBACK (gtk3_curve_model_notify), curve);
+
+  DEBUG_INFO("set model\n");
+
+  gtk3_curve_size_graph (curve);
+  gtk3_curve_model_changed (priv->model, curve);
+
+  g_object_notify (G_OBJECT (curve), "model");
+}
+
+Gtk3CurveModel *
+gtk3_curve_get_model (GtkWidget *widget)
+{
+  Gtk3Curve *curve = GTK3_CURVE (widget);
+  Gtk3CurvePrivate *priv = curve->priv;
+  return priv->model;
+}
 
-  priv->width = priv->curve_data.n_points;
+void
+gtk3_curve_set_gamma (GtkWidget *widget, gfloat gamma)
+{
+  Gtk3Curve *curve = GTK3_CURVE (widget);
+  Gtk3CurvePrivate *priv = curve->priv;
 
   DEBUG_INFO("set gamma \n");
-  if (gtk_widget_is_visible (GTK_WIDGET (curve)))
-    {
-      DEBUG_INFO("queue draw \n");
-      gtk_widget_queue_draw (GTK_WIDGET (curve));
-    }
+  gtk3_curve_model_set_gamma (priv->model, gamma);
+}
+
+void
+gtk3_curve_set_transfer (GtkWidget *widget, Gtk3CurveTransfer transfer)
+{
+  Gtk3Curve *curve = GTK3_CURVE (widget);
+  Gtk3CurvePrivate *priv = curve->priv;
+
+  DEBUG_INFO("set transfer %d\n", transfer);
+  gtk3_curve_model_set_transfer (priv->model, transfer);
 }
 
 void
@@ -1500,36 +2132,12 @@ gtk3_curve_set_range (GtkWidget *widget,
   DEBUG_INFO("min_x[%0.1f] max_x[%0.1f]\n", min_x, max_x);
   DEBUG_INFO("min_y[%0.1f] max_y[%0.1f]\n", min_y, max_y);
 
-  g_object_freeze_notify (G_OBJECT (curve));
-
-  if (priv->min_x != min_x)
-    {
-      priv->min_x = min_x;
-      g_object_notify (G_OBJECT (curve), "min-x");
-    }
-
-  if (priv->max_x != max_x)
-    {
-      priv->max_x = max_x;
-      g_object_notify (G_OBJECT (curve), "max-x");
-    }
-
-  if (priv->min_y != min_y)
-    {
-      priv->min_y = min_y;
-      g_object_notify (G_OBJECT (curve), "min-y");
-    }
-
-  if (priv->max_y != max_y)
-    {
-      priv->max_y = max_y;
-      g_object_notify (G_OBJECT (curve), "max-y");
-    }
-
-  g_object_thaw_notify (G_OBJECT (curve));
+  gtk3_curve_begin_update (widget);
+  gtk3_curve_model_set_range (priv->model, min_x, max_x, min_y, max_y);
 
   gtk3_curve_size_graph (curve);
-  gtk3_curve_reset_vector (widget);
+  gtk3_curve_model_reset (priv->model);
+  gtk3_curve_end_update (widget);
 
   DEBUG_INFO("set range [E]\n");
 }
@@ -1539,239 +2147,157 @@ gtk3_curve_get_vector (GtkWidget *widget, int veclen, gfloat vector[])
 {
   Gtk3Curve *curve = GTK3_CURVE (widget);
   Gtk3CurvePrivate *priv = curve->priv;
-  gfloat rx, ry, dx, dy, min_x, delta_x, *mem, *xv, *yv, *y2v, prev;
-  gint dst, i, x, next, num_active_ctlpoints = 0, first_active = -1;
-
-  min_x = priv->min_x;
-
-  if (priv->curve_data.curve_type != GTK3_CURVE_TYPE_FREE)
-    {
-      /* count active points: */
-      prev = min_x - 1.0;
-      for (i = num_active_ctlpoints = 0; i < priv->curve_data.n_cpoints; ++i)
-        if (priv->curve_data.d_cpoints[i].x > prev)
-          {
-            if (first_active < 0)
-              first_active = i;
-            prev = priv->curve_data.d_cpoints[i].x;
-            ++num_active_ctlpoints;
-          }
-
-      /* handle degenerate case: */
-      if (num_active_ctlpoints < 2)
-        {
-          if (num_active_ctlpoints > 0)
-            ry = priv->curve_data.d_cpoints[first_active].y;
-          else
-            ry = priv->min_y;
-          if (ry < priv->min_y) ry = priv->min_y;
-          if (ry > priv->max_y) ry = priv->max_y;
-          for (x = 0; x < veclen; ++x)
-            vector[x] = ry;
-          return;
-        }
-    }
 
-  switch (priv->curve_data.curve_type)
-    {
-    default:
-    case GTK3_CURVE_TYPE_SPLINE:
-      mem = g_malloc (3 * num_active_ctlpoints * sizeof (gfloat));
-      xv  = mem;
-      yv  = mem + num_active_ctlpoints;
-      y2v = mem + 2*num_active_ctlpoints;
-
-      prev = min_x - 1.0;
-      for (i = dst = 0; i < priv->curve_data.n_cpoints; ++i)
-        if (priv->curve_data.d_cpoints[i].x > prev)
-          {
-            prev    = priv->curve_data.d_cpoints[i].x;
-            xv[dst] = priv->curve_data.d_cpoints[i].x;
-            yv[dst] = priv->curve_data.d_cpoints[i].y;
-            ++dst;
-          }
-
-      spline_solve (num_active_ctlpoints, xv, yv, y2v);
-
-      rx = min_x;
-      dx = (priv->max_x - min_x) / (veclen - 1);
-      for (x = 0; x < veclen; ++x, rx += dx)
-        {
-          ry = spline_eval (num_active_ctlpoints, xv, yv, y2v, rx);
-          if (ry < priv->min_y) ry = priv->min_y;
-          if (ry > priv->max_y) ry = priv->max_y;
-          vector[x] = ry;
-        }
+  gtk3_curve_model_get_vector (priv->model, veclen, vector);
+}
 
-      g_free (mem);
-      break;
+void
+gtk3_curve_eval_points (GtkWidget *widget, const gfloat x[], gfloat y[], gint n)
+{
+  Gtk3Curve *curve = GTK3_CURVE (widget);
+  Gtk3CurvePrivate *priv = curve->priv;
 
-    case GTK3_CURVE_TYPE_LINEAR:
-      dx = (priv->max_x - min_x) / (veclen - 1);
-      rx = min_x;
-      ry = priv->min_y;
-      dy = 0.0;
-      i  = first_active;
-      for (x = 0; x < veclen; ++x, rx += dx)
-        {
-          if (rx >= priv->curve_data.d_cpoints[i].x)
-            {
-              if (rx > priv->curve_data.d_cpoints[i].x)
-                ry = priv->min_y;
-              dy = 0.0;
-              next = i + 1;
-              while (next < priv->curve_data.n_cpoints
-                     && priv->curve_data.d_cpoints[next].x <= priv->curve_data.d_cpoints[i].x)
-                ++next;
-              if (next < priv->curve_data.n_cpoints)
-                {
-                  delta_x = priv->curve_data.d_cpoints[next].x - priv->curve_data.d_cpoints[i].x;
-                  dy = ((priv->curve_data.d_cpoints[next].y - priv->curve_data.d_cpoints[i].y)
-                        / delta_x);
-                  dy *= dx;
-                  ry = priv->curve_data.d_cpoints[i].y;
-                  i = next;
-                }
-            }
-          vector[x] = ry;
-          ry += dy;
-        }
-      break;
+  gtk3_curve_model_eval_points (priv->model, x, y, n);
+}
 
-    case GTK3_CURVE_TYPE_FREE:
-      if (priv->curve_data.d_point)
-        {
-          rx = 0.0;
-          dx = priv->curve_data.n_points / (double) veclen;
-          for (x = 0; x < veclen; ++x, rx += dx)
-            vector[x] = unproject (RADIUS + priv->height - priv->curve_data.d_point[(int) rx].y,
-                                   priv->min_y, priv->max_y,
-                                   priv->height);
-        }
-      else
-        memset (vector, 0, veclen * sizeof (vector[0]));
-      break;
-    }
+gfloat
+gtk3_curve_eval (GtkWidget *widget, gfloat x)
+{
+  Gtk3Curve *curve = GTK3_CURVE (widget);
+  Gtk3CurvePrivate *priv = curve->priv;
+
+  return gtk3_curve_model_eval (priv->model, x);
 }
 
 void
-gtk3_curve_set_vector (GtkWidget *widget, int veclen, gfloat vector[])
+gtk3_curve_get_vector_full (GtkWidget *widget, gint veclen,
+                            Gtk3CurveFormat format, gpointer data,
+                            gint offset, gint stride)
 {
   Gtk3Curve *curve = GTK3_CURVE (widget);
   Gtk3CurvePrivate *priv = curve->priv;
-  Gtk3CurveType old_type;
-  GdkRectangle geom;
-  gfloat rx, dx, ry;
-  gint i, height;
-  GdkWindow *gdk_window = gtk_widget_get_window(GTK_WIDGET (curve));
-  GdkDisplay *gdk_display = gdk_window_get_display(gdk_window);
-  GdkMonitor *monitor = gdk_display_get_primary_monitor(gdk_display);
-  gdk_monitor_get_geometry(monitor, &geom);
 
+  gtk3_curve_model_get_vector_full (priv->model, veclen, format, data,
+                                    offset, stride);
+}
 
-  old_type = priv->curve_data.curve_type;
-  priv->curve_data.curve_type = GTK3_CURVE_TYPE_FREE;
+void
+gtk3_curve_get_lut_u8 (GtkWidget *widget, guint8 lut[256])
+{
+  Gtk3Curve *curve = GTK3_CURVE (widget);
+  Gtk3CurvePrivate *priv = curve->priv;
 
-  if (priv->curve_data.d_point)
-    height = gtk_widget_get_allocated_height(GTK_WIDGET (curve)) - RADIUS * 2;
-  else
-    {
-      height = (priv->max_y - priv->min_y);
-      if (height >geom.height / 4)
-        height = geom.height / 4;
+  gtk3_curve_model_get_lut_u8 (priv->model, lut);
+}
 
-      priv->height = height;
-      priv->curve_data.n_points = veclen;
-      priv->curve_data.d_point = g_malloc (priv->curve_data.n_points * sizeof (priv->curve_data.d_point[0]));
-    }
-  rx = 0;
-  dx = (veclen - 1.0) / (priv->curve_data.n_points - 1.0);
+void
+gtk3_curve_get_lut_u16 (GtkWidget *widget, gint bits, guint16 lut[])
+{
+  Gtk3Curve *curve = GTK3_CURVE (widget);
+  Gtk3CurvePrivate *priv = curve->priv;
 
-  for (i = 0; i < priv->curve_data.n_points; ++i, rx += dx)
-    {
-      ry = vector[(int) (rx + 0.5)];
-      if (ry > priv->max_y) ry = priv->max_y;
-      if (ry < priv->min_y) ry = priv->min_y;
-      priv->curve_data.d_point[i].x = RADIUS + i;
-      priv->curve_data.d_point[i].y =
-        RADIUS + height - project (ry, priv->min_y, priv->max_y, height);
-    }
-  if (old_type != GTK3_CURVE_TYPE_FREE)
-    {
-      g_signal_emit (curve, curve_type_changed_signal, 0);
-      g_object_notify (G_OBJECT (curve), "curve-type");
-    }
+  gtk3_curve_model_get_lut_u16 (priv->model, bits, lut);
+}
+
+void
+gtk3_curve_set_vector (GtkWidget *widget, int veclen, gfloat vector[])
+{
+  Gtk3Curve *curve = GTK3_CURVE (widget);
+  Gtk3CurvePrivate *priv = curve->priv;
 
   DEBUG_INFO("set vector \n");
+  gtk3_curve_model_set_vector (priv->model, veclen, vector);
+}
+
+/* Starts a batch of changes to the curve or its model.  Until the
+ * matching gtk3_curve_end_update nothing is interpolated, resized,
+ * redrawn or signalled; then it is all done once.  Updates nest. */
+void
+gtk3_curve_begin_update (GtkWidget *widget)
+{
+  Gtk3Curve *curve = GTK3_CURVE (widget);
+  Gtk3CurvePrivate *priv = curve->priv;
 
-  priv->width = priv->curve_data.n_points;
+  g_return_if_fail (GTK3_IS_CURVE (widget));
 
-  if (gtk_widget_is_visible (GTK_WIDGET (curve)))
-    {
-      DEBUG_INFO("queue draw\n");
-      gtk_widget_queue_draw (GTK_WIDGET (curve));
-    }
+  if (priv->freeze_count++ > 0)
+    return;
+
+  DEBUG_INFO("begin update\n");
+
+  g_object_freeze_notify (G_OBJECT (curve));
+  priv->frozen_model = g_object_ref (priv->model);
+  gtk3_curve_model_begin_update (priv->frozen_model);
 }
 
 void
-gtk3_curve_set_curve_type (GtkWidget *widget, Gtk3CurveType new_type)
+gtk3_curve_end_update (GtkWidget *widget)
 {
   Gtk3Curve *curve = GTK3_CURVE (widget);
   Gtk3CurvePrivate *priv = curve->priv;
-  gfloat rx, dx;
-  gint x, i;
+  Gtk3CurveModel *model;
 
-  if (new_type != priv->curve_data.curve_type)
-    {
-      gint width, height;
+  g_return_if_fail (GTK3_IS_CURVE (widget));
+  g_return_if_fail (priv->freeze_count > 0);
 
-      width = gtk_widget_get_allocated_width(widget) - RADIUS * 2;
-      height = gtk_widget_get_allocated_height(widget) - RADIUS * 2;
+  if (--priv->freeze_count > 0)
+    return;
 
-      if (new_type == GTK3_CURVE_TYPE_FREE)
-        {
-          gtk3_curve_interpolate (widget, width, height);
-          priv->curve_data.curve_type = new_type;
-        }
-      else if (priv->curve_data.curve_type == GTK3_CURVE_TYPE_FREE)
-        {
-          g_free (priv->curve_data.d_cpoints);
-          priv->curve_data.n_cpoints = 9;
-          priv->curve_data.d_cpoints = g_malloc (priv->curve_data.n_cpoints * sizeof (*priv->curve_data.d_cpoints));
+  DEBUG_INFO("end update\n");
 
-          rx = 0.0;
-          dx = (width - 1) / (gfloat) (priv->curve_data.n_cpoints - 1);
+  /* emits the model's one "changed", if it is still ours */
+  model = priv->frozen_model;
+  priv->frozen_model = NULL;
+  gtk3_curve_model_end_update (model);
+  g_object_unref (model);
 
-          for (i = 0; i < priv->curve_data.n_cpoints; ++i, rx += dx)
-            {
-              x = (int) (rx + 0.5);
-              priv->curve_data.d_cpoints[i].x =
-                unproject (x, priv->min_x, priv->max_x, width);
-              priv->curve_data.d_cpoints[i].y =
-                unproject (RADIUS + height - priv->curve_data.d_point[x].y,
-                           priv->min_y, priv->max_y, height);
-            }
+  if (priv->pending_size)
+    {
+      priv->pending_size = FALSE;
+      gtk3_curve_size_graph (curve);
+    }
+  if (priv->pending_changed)
+    gtk3_curve_model_changed (priv->model, curve);
+  if (priv->pending_draw)
+    {
+      priv->pending_draw = FALSE;
+      gtk3_curve_invalidate (curve, 0);
+    }
 
-          priv->curve_data.curve_type = new_type;
-          gtk3_curve_interpolate (widget, width, height);
-        }
-      else
-        {
-          priv->curve_data.curve_type = new_type;
-          gtk3_curve_interpolate (widget, width, height);
-        }
+  g_object_thaw_notify (G_OBJECT (curve));
+}
 
-      g_signal_emit (curve, curve_type_changed_signal, 0);
-      g_object_notify (G_OBJECT (curve), "curve-type");
+void
+gtk3_curve_set_control_points (GtkWidget             *widget,
+                               gint                   n_points,
+                               const Gtk3CurveVector  points[])
+{
+  Gtk3Curve *curve = GTK3_CURVE (widget);
+  Gtk3CurvePrivate *priv = curve->priv;
 
-      DEBUG_INFO("set curve type\n");
+  DEBUG_INFO("set control points \n");
+  gtk3_curve_model_set_points (priv->model, n_points, points);
+}
 
-      if (gtk_widget_is_visible (GTK_WIDGET (curve)))
-        {
-          DEBUG_INFO("queue draw\n");
-          gtk_widget_queue_draw (GTK_WIDGET (curve));
-        }
-    }
+gint
+gtk3_curve_get_control_points (GtkWidget       *widget,
+                               gint             n_points,
+                               Gtk3CurveVector  points[])
+{
+  Gtk3Curve *curve = GTK3_CURVE (widget);
+  Gtk3CurvePrivate *priv = curve->priv;
+
+  return gtk3_curve_model_get_points (priv->model, n_points, points);
+}
+
+void
+gtk3_curve_set_curve_type (GtkWidget *widget, Gtk3CurveType new_type)
+{
+  Gtk3Curve *curve = GTK3_CURVE (widget);
+  Gtk3CurvePrivate *priv = curve->priv;
+
+  DEBUG_INFO("set curve type\n");
+  gtk3_curve_model_set_curve_type (priv->model, new_type);
 }
 
 void gtk3_curve_set_color_background (GtkWidget *widget, Gtk3CurveColor color)
@@ -1782,11 +2308,7 @@ void gtk3_curve_set_color_background (GtkWidget *widget, Gtk3CurveColor color)
   priv->background.green = color.green;
   priv->background.blue = color.blue;
   priv->background.alpha = color.alpha;
-  if (gtk_widget_is_visible (widget))
-    {
-      DEBUG_INFO("queue draw\n");
-      gtk_widget_queue_draw (widget);
-    }
+  gtk3_curve_invalidate (curve, DIRTY_STYLE);
 }
 
 void gtk3_curve_set_color_background_rgba (GtkWidget *widget, gfloat r,
@@ -1798,11 +2320,7 @@ void gtk3_curve_set_color_background_rgba (GtkWidget *widget, gfloat r,
   priv->background.green = g;
   priv->background.blue = b;
   priv->background.alpha = a;
-  if (gtk_widget_is_visible (widget))
-    {
-      DEBUG_INFO("queue draw\n");
-      gtk_widget_queue_draw (widget);
-    }
+  gtk3_curve_invalidate (curve, DIRTY_STYLE);
 }
 
 Gtk3CurveColor gtk3_curve_get_color_background (GtkWidget *widget)
@@ -1820,11 +2338,7 @@ void gtk3_curve_set_color_grid (GtkWidget *widget, Gtk3CurveColor color)
   priv->grid.green = color.green;
   priv->grid.blue = color.blue;
   priv->grid.alpha = color.alpha;
-  if (gtk_widget_is_visible (widget))
-    {
-      DEBUG_INFO("queue draw\n");
-      gtk_widget_queue_draw (widget);
-    }
+  gtk3_curve_invalidate (curve, DIRTY_STYLE);
 }
 
 void gtk3_curve_set_color_grid_rgba (GtkWidget *widget, gfloat r,
@@ -1836,11 +2350,7 @@ void gtk3_curve_set_color_grid_rgba (GtkWidget *widget, gfloat r,
   priv->grid.green = g;
   priv->grid.blue = b;
   priv->grid.alpha = a;
-  if (gtk_widget_is_visible (widget))
-    {
-      DEBUG_INFO("queue draw\n");
-      gtk_widget_queue_draw (widget);
-    }
+  gtk3_curve_invalidate (curve, DIRTY_STYLE);
 }
 
 Gtk3CurveColor gtk3_curve_get_color_grid (GtkWidget *widget)
@@ -1858,11 +2368,7 @@ void gtk3_curve_set_color_curve (GtkWidget *widget, Gtk3CurveColor color)
   priv->curve.green = color.green;
   priv->curve.blue = color.blue;
   priv->curve.alpha = color.alpha;
-  if (gtk_widget_is_visible (widget))
-    {
-      DEBUG_INFO("queue draw\n");
-      gtk_widget_queue_draw (widget);
-    }
+  gtk3_curve_invalidate (curve, DIRTY_STYLE);
 }
 
 void gtk3_curve_set_color_curve_rgba (GtkWidget *widget, gfloat r,
@@ -1874,11 +2380,7 @@ void gtk3_curve_set_color_curve_rgba (GtkWidget *widget, gfloat r,
   priv->curve.green = g;
   priv->curve.blue = b;
   priv->curve.alpha = a;
-  if (gtk_widget_is_visible (widget))
-    {
-      DEBUG_INFO("queue draw\n");
-      gtk_widget_queue_draw (widget);
-    }
+  gtk3_curve_invalidate (curve, DIRTY_STYLE);
 }
 
 Gtk3CurveColor gtk3_curve_get_color_curve (GtkWidget *widget)
@@ -1896,11 +2398,7 @@ void gtk3_curve_set_color_cpoint (GtkWidget *widget, Gtk3CurveColor color)
   priv->cpoint.green = color.green;
   priv->cpoint.blue = color.blue;
   priv->cpoint.alpha = color.alpha;
-  if (gtk_widget_is_visible (widget))
-    {
-      DEBUG_INFO("queue draw\n");
-      gtk_widget_queue_draw (widget);
-    }
+  gtk3_curve_invalidate (curve, DIRTY_STYLE);
 }
 
 void gtk3_curve_set_color_cpoint_rgba (GtkWidget *widget, gfloat r,
@@ -1912,11 +2410,7 @@ void gtk3_curve_set_color_cpoint_rgba (GtkWidget *widget, gfloat r,
   priv->cpoint.green = g;
   priv->cpoint.blue = b;
   priv->cpoint.alpha = a;
-  if (gtk_widget_is_visible (widget))
-    {
-      DEBUG_INFO("queue draw\n");
-      gtk_widget_queue_draw (widget);
-    }
+  gtk3_curve_invalidate (curve, DIRTY_STYLE);
 }
 
 Gtk3CurveColor gtk3_curve_get_color_cpoint (GtkWidget *widget)
@@ -1932,7 +2426,7 @@ Gtk3CurveType gtk3_curve_get_curve_type (GtkWidget *widget)
 {
   Gtk3Curve *curve = GTK3_CURVE (widget);
   Gtk3CurvePrivate *priv = curve->priv;
-  return  priv->curve_data.curve_type;
+  return  gtk3_curve_model_get_curve_type (priv->model);
 }
 
 void gtk3_curve_set_use_theme_background(GtkWidget *widget, gboolean use)
@@ -1940,6 +2434,7 @@ void gtk3_curve_set_use_theme_background(GtkWidget *widget, gboolean use)
   Gtk3Curve *curve = GTK3_CURVE (widget);
   Gtk3CurvePrivate *priv = curve->priv;
   priv->use_bg_theme = use;
+  gtk3_curve_invalidate (curve, DIRTY_STYLE);
 }
 
 gboolean gtk3_curve_get_use_theme_background(GtkWidget *widget)
@@ -1949,11 +2444,29 @@ gboolean gtk3_curve_get_use_theme_background(GtkWidget *widget)
   return priv->use_bg_theme;
 }
 
+/* A windowless curve draws on its parent's window and only has an
+ * input-only window of its own.  Must be set before it is realized. */
+void gtk3_curve_set_windowless(GtkWidget *widget, gboolean windowless)
+{
+  g_return_if_fail (GTK3_IS_CURVE (widget));
+  g_return_if_fail (!gtk_widget_get_realized (widget));
+
+  gtk_widget_set_has_window (widget, !windowless);
+}
+
+gboolean gtk3_curve_get_windowless(GtkWidget *widget)
+{
+  g_return_val_if_fail (GTK3_IS_CURVE (widget), FALSE);
+
+  return !gtk_widget_get_has_window (widget);
+}
+
 void gtk3_curve_set_grid_size(GtkWidget *widget, Gtk3CurveGridSize size)
 {
   Gtk3Curve *curve = GTK3_CURVE (widget);
   Gtk3CurvePrivate *priv = curve->priv;
   priv->grid_size = size;
+  gtk3_curve_invalidate (curve, DIRTY_STYLE);
 }
 
 Gtk3CurveGridSize gtk3_curve_get_grid_size(GtkWidget *widget)
@@ -1968,17 +2481,9 @@ gtk3_curve_reset (GtkWidget *widget)
 {
   Gtk3Curve *curve = GTK3_CURVE (widget);
   Gtk3CurvePrivate *priv = curve->priv;
-  Gtk3CurveType old_type;
-
-  old_type = priv->curve_data.curve_type;
-  priv->curve_data.curve_type = GTK3_CURVE_TYPE_SPLINE;
-  gtk3_curve_reset_vector (widget);
 
-  if (old_type != GTK3_CURVE_TYPE_SPLINE)
-    {
-       g_signal_emit (curve, curve_type_changed_signal, 0);
-       g_object_notify (G_OBJECT (curve), "curve-type");
-    }
+  gtk3_curve_model_set_curve_type (priv->model, GTK3_CURVE_TYPE_SPLINE);
+  gtk3_curve_model_reset (priv->model);
 }
 
 void
@@ -19,6 +19,8 @@
 
 #include <gtk/gtk.h>
 
+#include "gtk3curvemodel.h"
+
 #define GTK3_TYPE_CURVE                  (gtk3_curve_get_type ())
 #define GTK3_CURVE(obj)                  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GTK3_TYPE_CURVE, Gtk3Curve))
 #define GTK3_IS_CURVE(obj)               (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GTK3_TYPE_CURVE))
@@ -26,8 +28,6 @@
 #define GTK3_IS_CURVE_CLASS(klass)       (G_TYPE_CHECK_CLASS_TYPE  ((klass), GTK3_TYPE_CURVE))
 #define GTK3_CURVE_GET_CLASS(obj)        (G_TYPE_INSTANCE_GET_CLASS  ((obj), GTK3_TYPE_CURVE, Gtk3CurveClass))
 
-#define GTK3_TYPE_CURVE_TYPE             (gtk3_curve_type_get_type ())
-
 typedef enum
 {
   GTK3_CURVE_GRID_MICRO,
@@ -37,20 +37,11 @@ typedef enum
   GTK3_CURVE_GRID_XLARGE
 } Gtk3CurveGridSize;
 
-
-typedef enum
-{
-  GTK3_CURVE_TYPE_LINEAR,       /* linear interpolation */
-  GTK3_CURVE_TYPE_SPLINE,       /* spline interpolation */
-  GTK3_CURVE_TYPE_FREE          /* free form curve */
-} Gtk3CurveType;
-
 typedef struct _Gtk3Curve           Gtk3Curve;
 typedef struct _Gtk3CurveClass      Gtk3CurveClass;
 typedef struct _Gtk3CurvePrivate    Gtk3CurvePrivate;
 typedef struct _Gtk3CurveColor      Gtk3CurveColor;
 typedef struct _Gtk3CurveData       Gtk3CurveData;
-typedef struct _Gtk3CurveVector     Gtk3CurveVector;
 typedef struct _Gtk3CurvePoint      Gtk3CurvePoint;
 
 struct _Gtk3CurvePoint
@@ -67,12 +58,6 @@ struct _Gtk3CurveColor
   gfloat alpha;
 };
 
-struct _Gtk3CurveVector
-{
-  gfloat x;
-  gfloat y;
-};
-
 struct _Gtk3CurveData
 {
   gchar            *description;
@@ -97,21 +82,34 @@ struct _Gtk3CurveClass
   GtkWidgetClass parent_class;
 
   void (* curve_type_changed) (Gtk3Curve *curve);
+  /* [x1, x2] of the x range changed, up to the model revision given */
+  void (* changed)            (Gtk3Curve *curve,
+                               gfloat     x1,
+                               gfloat     x2,
+                               guint      revision);
 
   /* Padding for future expansion */
-  void (*_gtk_reserved1) (void);
   void (*_gtk_reserved2) (void);
   void (*_gtk_reserved3) (void);
   void (*_gtk_reserved4) (void);
 };
 
-GType gtk3_curve_type_get_type (void);
 GType gtk3_curve_get_type (void) G_GNUC_CONST;
 GtkWidget*  gtk3_curve_new (void);
+GtkWidget*  gtk3_curve_new_with_model (Gtk3CurveModel *model);
+
+void gtk3_curve_set_model                         (GtkWidget         *widget,
+                                                   Gtk3CurveModel    *model);
+Gtk3CurveModel *gtk3_curve_get_model              (GtkWidget         *widget);
+
+void gtk3_curve_begin_update                      (GtkWidget         *widget);
+void gtk3_curve_end_update                        (GtkWidget         *widget);
 
 void gtk3_curve_reset                             (GtkWidget         *widget);
 void gtk3_curve_set_gamma                         (GtkWidget         *widget,
                                                    gfloat             gamma_);
+void gtk3_curve_set_transfer                      (GtkWidget         *widget,
+                                                   Gtk3CurveTransfer  transfer);
 void gtk3_curve_set_range                         (GtkWidget         *widget,
                                                    gfloat             min_x,
                                                    gfloat             max_x,
@@ -120,9 +118,32 @@ void gtk3_curve_set_range                         (GtkWidget         *widget,
 void gtk3_curve_get_vector                        (GtkWidget         *widget,
                                                    gint               veclen,
                                                    gfloat             vector[]);
+void gtk3_curve_eval_points                       (GtkWidget         *widget,
+                                                   const gfloat       x[],
+                                                   gfloat             y[],
+                                                   gint               n);
+gfloat gtk3_curve_eval                            (GtkWidget         *widget,
+                                                   gfloat             x);
+void gtk3_curve_get_vector_full                   (GtkWidget         *widget,
+                                                   gint               veclen,
+                                                   Gtk3CurveFormat    format,
+                                                   gpointer           data,
+                                                   gint               offset,
+                                                   gint               stride);
+void gtk3_curve_get_lut_u8                        (GtkWidget         *widget,
+                                                   guint8             lut[256]);
+void gtk3_curve_get_lut_u16                       (GtkWidget         *widget,
+                                                   gint               bits,
+                                                   guint16            lut[]);
 void gtk3_curve_set_vector                        (GtkWidget         *widget,
                                                    gint               veclen,
                                                    gfloat             vector[]);
+void gtk3_curve_set_control_points                (GtkWidget         *widget,
+                                                   gint               n_points,
+                                                   const Gtk3CurveVector points[]);
+gint gtk3_curve_get_control_points                (GtkWidget         *widget,
+                                                   gint               n_points,
+                                                   Gtk3CurveVector    points[]);
 void gtk3_curve_set_curve_type                    (GtkWidget         *widget,
                                                    Gtk3CurveType      type);
 
@@ -165,6 +186,9 @@ Gtk3CurveColor gtk3_curve_get_color_cpoint        (GtkWidget          *widget);
 void gtk3_curve_set_use_theme_background          (GtkWidget          *widget,
                                                    gboolean            use);
 gboolean gtk3_curve_get_use_theme_background      (GtkWidget          *widget);
+void gtk3_curve_set_windowless                    (GtkWidget          *widget,
+                                                   gboolean            windowless);
+gboolean gtk3_curve_get_windowless                (GtkWidget          *widget);
 void gtk3_curve_set_grid_size                     (GtkWidget          *widget,
                                                    Gtk3CurveGridSize   size);
 Gtk3CurveGridSize gtk3_curve_get_grid_size        (GtkWidget          *widget);
@@ -0,0 +1,1264 @@
+/* Copyright (C) 2016 Benoit Touchette
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation version
+ * 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Portions of this code Copyright (C) 1997 David Mosberger and
+ * Copyright (C) 1997 - 2000 GTK+ Team.
+ */
+
+/* Interpolators, one per curve type.  The piecewise cubic ones rewrite
+ * every span in power form once, when the points change, and evaluate
+ * runs of samples sharing a span with the cubic kernel.  The analytic
+ * ones only have their parameters and go straight to their kernels. */
+
+#include <string.h>
+#include <math.h>
+
+#include <glib.h>
+
+#include "gtk3curveinterp.h"
+#include "gtk3curvekernels.h"
+
+/* what piecewise_eval does outside the knots */
+typedef enum
+{
+  EDGE_MIN_Y,           /* min_y, as the linear curve always did */
+  EDGE_EXTEND,          /* continue the first or last span */
+  EDGE_HOLD             /* the value at the first or last knot */
+} Edge;
+
+/* power form coefficients of each span, 4 per span */
+typedef struct
+{
+  gint n_alloc;
+  gfloat *c;
+} LinearState;
+
+/* second derivatives at the knots, and the coefficients */
+typedef struct
+{
+  gint n_alloc;
+  gfloat *d_block;
+  gfloat *y2;
+  gfloat *u;
+  gfloat *c;
+} SplineState;
+
+/* knot values s, tangents out of (m) and into (nt) each knot, and the
+ * coefficients of the cubic Hermite spans between them */
+typedef struct
+{
+  gint n_alloc;
+  gfloat *d_block;
+  gfloat *s;
+  gfloat *m;
+  gfloat *nt;
+  gfloat *c;
+} HermiteState;
+
+/* sets the knots start <= k < end of a Hermite state */
+typedef void (* HermiteKnotsFunc) (HermiteState          *st,
+                                   const Gtk3CurvePoints *p,
+                                   gint                   start,
+                                   gint                   end);
+
+static void spline_solve                    (int                   n,
+                                             const gfloat          x[],
+                                             const gfloat          y[],
+                                             gfloat                y2[],
+                                             gfloat                u[]);
+static void spline_coefficients             (int                   n,
+                                             const gfloat          x[],
+                                             const gfloat          y[],
+                                             const gfloat          y2[],
+                                             gfloat                c[]);
+static void linear_coefficients             (int                   n,
+                                             const gfloat          x[],
+                                             const gfloat          y[],
+                                             gfloat                c[]);
+static void monotone_tangents               (int                   n,
+                                             const gfloat          x[],
+                                             const gfloat          y[],
+                                             gfloat                m[],
+                                             gint                  start,
+                                             gint                  end);
+static void cardinal_tangents               (int                   n,
+                                             const gfloat          x[],
+                                             const gfloat          y[],
+                                             gfloat                tension,
+                                             gfloat                m[],
+                                             gint                  start,
+                                             gint                  end);
+static void bezier_tangents                 (const gfloat          l[],
+                                             const gfloat          r[],
+                                             gfloat                m[],
+                                             gfloat                nt[],
+                                             gint                  start,
+                                             gint                  end);
+static void bspline_values                  (int                   n,
+                                             const gfloat          y[],
+                                             gfloat                s[],
+                                             gint                  start,
+                                             gint                  end);
+static void hermite_coefficients            (int                   n,
+                                             const gfloat          x[],
+                                             const gfloat          y[],
+                                             const gfloat          m[],
+                                             const gfloat          nt[],
+                                             gfloat                c[]);
+static gint span_find                       (int                   n,
+                                             const gfloat          x[],
+                                             gfloat                val);
+static void piecewise_eval                  (int                   n,
+                                             const gfloat          x[],
+                                             const gfloat          c[],
+                                             Edge                  edge,
+                                             gfloat                x0,
+                                             gfloat                dx,
+                                             gfloat                min_y,
+                                             gfloat                max_y,
+                                             gint                  start,
+                                             gint                  end,
+                                             gfloat                vector[]);
+static void piecewise_points                (int                   n,
+                                             const gfloat          x[],
+                                             const gfloat          c[],
+                                             Edge                  edge,
+                                             gfloat                min_y,
+                                             gfloat                max_y,
+                                             const gfloat          px[],
+                                             gfloat                py[],
+                                             gint                  n_points,
+                                             gboolean              sorted);
+
+/*                          =====================                          */
+/* ===========================     LINEAR     ============================ */
+/*                          =====================                          */
+
+static gpointer
+linear_state_new (void)
+{
+  return g_new0 (LinearState, 1);
+}
+
+static void
+linear_state_free (gpointer state)
+{
+  LinearState *st = state;
+
+  g_free (st->c);
+  g_free (st);
+}
+
+static void
+linear_prepare (gpointer state, const Gtk3CurvePoints *p)
+{
+  LinearState *st = state;
+
+  if (st->n_alloc < p->n)
+    {
+      st->n_alloc = p->n;
+      g_free (st->c);
+      st->c = g_malloc (4 * st->n_alloc * sizeof (gfloat));
+    }
+
+  linear_coefficients (p->n, p->x, p->y, st->c);
+}
+
+/* a point only reaches the two lines ending at it */
+static void
+linear_update_local (gpointer state, const Gtk3CurvePoints *p, gint i)
+{
+  LinearState *st = state;
+  gint lo, hi;
+
+  lo = MAX (i - 1, 0);
+  hi = MIN (i, p->n - 2);
+  linear_coefficients (hi - lo + 2, p->x + lo, p->y + lo, st->c + 4 * lo);
+}
+
+static void
+linear_eval_range (gpointer state, const Gtk3CurvePoints *p,
+                   gint veclen, gint start, gint end, gfloat vector[])
+{
+  LinearState *st = state;
+
+  piecewise_eval (p->n, p->x, st->c, EDGE_MIN_Y,
+                  p->min_x, (p->max_x - p->min_x) / (veclen - 1),
+                  p->min_y, p->max_y, start, end, vector);
+}
+
+static void
+linear_eval_points (gpointer state, const Gtk3CurvePoints *p,
+                    const gfloat x[], gfloat y[], gint n, gboolean sorted)
+{
+  LinearState *st = state;
+
+  piecewise_points (p->n, p->x, st->c, EDGE_MIN_Y, p->min_y, p->max_y,
+                    x, y, n, sorted);
+}
+
+static void
+linear_knots (gpointer state, const Gtk3CurvePoints *p, Gtk3CurveKnots *knots)
+{
+  knots->value  = p->y;
+  knots->d_out  = NULL;
+  knots->d_in   = NULL;
+  knots->order  = 0;
+  knots->weight = 0.0;
+}
+
+/*                          =====================                          */
+/* ===========================     SPLINE     ============================ */
+/*                          =====================                          */
+
+static gpointer
+spline_state_new (void)
+{
+  return g_new0 (SplineState, 1);
+}
+
+static void
+spline_state_free (gpointer state)
+{
+  SplineState *st = state;
+
+  g_free (st->d_block);
+  g_free (st);
+}
+
+/* the natural spline couples all knots, every change solves it again */
+static void
+spline_prepare (gpointer state, const Gtk3CurvePoints *p)
+{
+  SplineState *st = state;
+
+  if (st->n_alloc < p->n)
+    {
+      st->n_alloc = p->n;
+      g_free (st->d_block);
+      st->d_block = g_malloc (6 * st->n_alloc * sizeof (gfloat));
+      st->y2 = st->d_block;
+      st->u  = st->d_block + st->n_alloc;
+      st->c  = st->d_block + 2 * st->n_alloc;
+    }
+
+  spline_solve (p->n, p->x, p->y, st->y2, st->u);
+  spline_coefficients (p->n, p->x, p->y, st->y2, st->c);
+}
+
+static void
+spline_eval_range (gpointer state, const Gtk3CurvePoints *p,
+                   gint veclen, gint start, gint end, gfloat vector[])
+{
+  SplineState *st = state;
+
+  piecewise_eval (p->n, p->x, st->c, EDGE_EXTEND,
+                  p->min_x, (p->max_x - p->min_x) / (veclen - 1),
+                  p->min_y, p->max_y, start, end, vector);
+}
+
+static void
+spline_eval_points (gpointer state, const Gtk3CurvePoints *p,
+                    const gfloat x[], gfloat y[], gint n, gboolean sorted)
+{
+  SplineState *st = state;
+
+  piecewise_points (p->n, p->x, st->c, EDGE_EXTEND, p->min_y, p->max_y,
+                    x, y, n, sorted);
+}
+
+/* between two knots the spline is a y[k] + b y[k + 1] plus ((a^3 - a)
+ * y2[k] + (b^3 - b) y2[k + 1]) h^2 / 6 with a, b in [0, 1], and |a^3 - a|
+ * <= 2 / (3 sqrt (3)) = 0.3849 */
+static void
+spline_knots (gpointer state, const Gtk3CurvePoints *p, Gtk3CurveKnots *knots)
+{
+  SplineState *st = state;
+
+  knots->value  = p->y;
+  knots->d_out  = st->y2;
+  knots->d_in   = st->y2;
+  knots->order  = 2;
+  knots->weight = 0.3849002 / 6.0;
+}
+
+/*                          =====================                          */
+/* ===========================    HERMITE     ============================ */
+/*                          =====================                          */
+
+static gpointer
+hermite_state_new (void)
+{
+  return g_new0 (HermiteState, 1);
+}
+
+static void
+hermite_state_free (gpointer state)
+{
+  HermiteState *st = state;
+
+  g_free (st->d_block);
+  g_free (st);
+}
+
+/* Sets the knots start <= k < end with knots_func and rewrites the spans
+ * next to them. */
+static void
+hermite_update (HermiteState          *st,
+                const Gtk3CurvePoints *p,
+                HermiteKnotsFunc       knots_func,
+                gint                   start,
+                gint                   end)
+{
+  gint lo, hi;
+
+  if (st->n_alloc < p->n)
+    {
+      st->n_alloc = p->n;
+      g_free (st->d_block);
+      st->d_block = g_malloc (7 * st->n_alloc * sizeof (gfloat));
+      st->s  = st->d_block;
+      st->m  = st->d_block + st->n_alloc;
+      st->nt = st->d_block + 2 * st->n_alloc;
+      st->c  = st->d_block + 3 * st->n_alloc;
+    }
+
+  knots_func (st, p, start, end);
+
+  /* span k runs from knot k to k + 1 */
+  lo = MAX (start - 1, 0);
+  hi = MIN (end, p->n - 1);
+  hermite_coefficients (hi - lo + 1, p->x + lo, st->s + lo, st->m + lo,
+                        st->nt + lo, st->c + 4 * lo);
+}
+
+/* Knot k depends on the points k - 1 to k + 1, the monotone end tangents
+ * on the first or last three. */
+static void
+hermite_update_local (HermiteState          *st,
+                      const Gtk3CurvePoints *p,
+                      HermiteKnotsFunc       knots_func,
+                      gint                   i)
+{
+  gint lo, hi;
+
+  lo = i <= 2 ? 0 : i - 1;
+  hi = i >= p->n - 3 ? p->n : i + 2;
+  hermite_update (st, p, knots_func, lo, hi);
+}
+
+static void
+hermite_eval_range (gpointer state, const Gtk3CurvePoints *p,
+                    gint veclen, gint start, gint end, gfloat vector[])
+{
+  HermiteState *st = state;
+
+  piecewise_eval (p->n, p->x, st->c, EDGE_HOLD,
+                  p->min_x, (p->max_x - p->min_x) / (veclen - 1),
+                  p->min_y, p->max_y, start, end, vector);
+}
+
+static void
+hermite_eval_points (gpointer state, const Gtk3CurvePoints *p,
+                     const gfloat x[], gfloat y[], gint n, gboolean sorted)
+{
+  HermiteState *st = state;
+
+  piecewise_points (p->n, p->x, st->c, EDGE_HOLD, p->min_y, p->max_y,
+                    x, y, n, sorted);
+}
+
+/* a Hermite span is a s[k] + b s[k + 1] plus (a b^2 m[k] - a^2 b
+ * nt[k + 1]) h, whose weights are at most 4 / 27 */
+static void
+hermite_knots (gpointer state, const Gtk3CurvePoints *p, Gtk3CurveKnots *knots)
+{
+  HermiteState *st = state;
+
+  knots->value  = st->s;
+  knots->d_out  = st->m;
+  knots->d_in   = st->nt;
+  knots->order  = 1;
+  knots->weight = 4.0 / 27.0;
+}
+
+/* knots through the points with the same tangent on both sides */
+static void
+hermite_smooth_knots (HermiteState *st, const Gtk3CurvePoints *p,
+                      gint start, gint end)
+{
+  memcpy (st->s + start, p->y + start, (end - start) * sizeof (gfloat));
+  memcpy (st->nt + start, st->m + start, (end - start) * sizeof (gfloat));
+}
+
+static void
+monotone_knots (HermiteState *st, const Gtk3CurvePoints *p,
+                gint start, gint end)
+{
+  monotone_tangents (p->n, p->x, p->y, st->m, start, end);
+  hermite_smooth_knots (st, p, start, end);
+}
+
+static void
+catmull_rom_knots (HermiteState *st, const Gtk3CurvePoints *p,
+                   gint start, gint end)
+{
+  cardinal_tangents (p->n, p->x, p->y, p->tension, st->m, start, end);
+  hermite_smooth_knots (st, p, start, end);
+}
+
+static void
+bezier_knots (HermiteState *st, const Gtk3CurvePoints *p,
+              gint start, gint end)
+{
+  memcpy (st->s + start, p->y + start, (end - start) * sizeof (gfloat));
+  cardinal_tangents (p->n, p->x, p->y, p->tension, st->m, start, end);
+  bezier_tangents (p->l, p->r, st->m, st->nt, start, end);
+}
+
+static void
+bspline_knots (HermiteState *st, const Gtk3CurvePoints *p,
+               gint start, gint end)
+{
+  bspline_values (p->n, p->y, st->s, start, end);
+  cardinal_tangents (p->n, p->x, p->y, 0.0, st->m, start, end);
+  memcpy (st->nt + start, st->m + start, (end - start) * sizeof (gfloat));
+}
+
+#define HERMITE_TYPE(name)                                                  \
+static void                                                                 \
+name##_prepare (gpointer state, const Gtk3CurvePoints *p)                   \
+{                                                                           \
+  hermite_update (state, p, name##_knots, 0, p->n);                         \
+}                                                                           \
+                                                                            \
+static void                                                                 \
+name##_update_local (gpointer state, const Gtk3CurvePoints *p, gint i)      \
+{                                                                           \
+  hermite_update_local (state, p, name##_knots, i);                         \
+}
+
+HERMITE_TYPE (monotone)
+HERMITE_TYPE (catmull_rom)
+HERMITE_TYPE (bezier)
+HERMITE_TYPE (bspline)
+
+#undef HERMITE_TYPE
+
+/*                          =====================                          */
+/* ===========================      FREE      ============================ */
+/*                          =====================                          */
+
+static void
+free_eval_range (gpointer state, const Gtk3CurvePoints *p,
+                 gint veclen, gint start, gint end, gfloat vector[])
+{
+  if (p->samples)
+    gtk3_curve_kernels_get ()->resample (p->samples, p->n_samples,
+                                         veclen, start, end, vector);
+  else
+    memset (vector, 0, (end - start) * sizeof (vector[0]));
+}
+
+/* the nearest sample, the samples evenly spaced over [min_x, max_x] */
+static void
+free_eval_points (gpointer state, const Gtk3CurvePoints *p,
+                  const gfloat x[], gfloat y[], gint n, gboolean sorted)
+{
+  gfloat scale, u;
+  gint j;
+
+  if (p->samples == NULL)
+    {
+      memset (y, 0, n * sizeof (y[0]));
+      return;
+    }
+
+  scale = (p->n_samples - 1) / (p->max_x - p->min_x);
+  for (j = 0; j < n; ++j)
+    {
+      u = (x[j] - p->min_x) * scale + 0.5f;
+      u = CLAMP (u, 0.0f, (gfloat) (p->n_samples - 1));
+      y[j] = p->samples[(gint) u];
+    }
+}
+
+/*                          =====================                          */
+/* ===========================    ANALYTIC    ============================ */
+/*                          =====================                          */
+
+/* Analytic curves map u = (x - min_x) / (max_x - min_x), 0 to 1, to v,
+ * 0 to 1 at the ends of the range, and v to [min_y, max_y].  Each is
+ * handed to one of the analytic kernels with the argument and result
+ * transformed, so they are only as accurate as those are. */
+
+/* v = u^(1 / gamma), params gamma; gamma <= 0 is taken as 1 */
+static void
+gamma_eval_range (gpointer state, const Gtk3CurvePoints *p,
+                  gint veclen, gint start, gint end, gfloat vector[])
+{
+  gfloat e;
+
+  e = p->params[0] > 0.0 ? 1.0 / p->params[0] : 1.0;
+  gtk3_curve_kernels_get ()->power (e, p->max_y - p->min_y, p->min_y,
+                                    0.0, 1.0 / (veclen - 1),
+                                    p->min_y, p->max_y, start, end, vector);
+}
+
+static gdouble
+gamma_value (const Gtk3CurvePoints *p, gdouble u)
+{
+  return u > 0.0 ? pow (u, p->params[0] > 0.0 ? 1.0 / p->params[0] : 1.0) : 0.0;
+}
+
+/* logistic curve 1 / (1 + e^(-contrast (u - midpoint))), stretched so
+ * it goes through (0, 0) and (1, 1); params contrast, midpoint.
+ * Contrasts below 0.1 are taken as 0.1.  With a = contrast log2(e) it is
+ * 1 / (1 + 2^(a midpoint - a u)). */
+static void
+sigmoid_eval_range (gpointer state, const Gtk3CurvePoints *p,
+                    gint veclen, gint start, gint end, gfloat vector[])
+{
+  gdouble a, s0, s1, scale;
+
+  a  = MAX (p->params[0], 0.1) / G_LN2;
+  s0 = 1.0 / (1.0 + exp2 (a * p->params[1]));
+  s1 = 1.0 / (1.0 + exp2 (a * p->params[1] - a));
+  scale = (p->max_y - p->min_y) / (s1 - s0);
+
+  gtk3_curve_kernels_get ()->logistic (scale, p->min_y - scale * s0,
+                                       a * p->params[1], -a / (veclen - 1),
+                                       p->min_y, p->max_y, start, end, vector);
+}
+
+static gdouble
+sigmoid_value (const Gtk3CurvePoints *p, gdouble u)
+{
+  gdouble a, s0, s1;
+
+  a  = MAX (p->params[0], 0.1) / G_LN2;
+  s0 = 1.0 / (1.0 + exp2 (a * p->params[1]));
+  s1 = 1.0 / (1.0 + exp2 (a * p->params[1] - a));
+  return (1.0 / (1.0 + exp2 (a * p->params[1] - a * u)) - s0) / (s1 - s0);
+}
+
+/* v = log(1 + strength u) / log(1 + strength), params strength;
+ * strengths below 0.1 are taken as 0.1 */
+static void
+log_eval_range (gpointer state, const Gtk3CurvePoints *p,
+                gint veclen, gint start, gint end, gfloat vector[])
+{
+  gdouble k;
+
+  k = MAX (p->params[0], 0.1);
+  gtk3_curve_kernels_get ()->logarithm ((p->max_y - p->min_y) / log2 (1.0 + k),
+                                        p->min_y, 1.0, k / (veclen - 1),
+                                        p->min_y, p->max_y, start, end, vector);
+}
+
+static gdouble
+log_value (const Gtk3CurvePoints *p, gdouble u)
+{
+  gdouble k;
+
+  k = MAX (p->params[0], 0.1);
+  return log2 (1.0 + k * u) / log2 (1.0 + k);
+}
+
+/* v = offset + gain u^exponent, params exponent, gain, offset */
+static void
+power_eval_range (gpointer state, const Gtk3CurvePoints *p,
+                  gint veclen, gint start, gint end, gfloat vector[])
+{
+  gfloat range;
+
+  range = p->max_y - p->min_y;
+  gtk3_curve_kernels_get ()->power (p->params[0], range * p->params[1],
+                                    p->min_y + range * p->params[2],
+                                    0.0, 1.0 / (veclen - 1),
+                                    p->min_y, p->max_y, start, end, vector);
+}
+
+/* u^exponent is 0 for u <= 0, as in the power kernel */
+static gdouble
+power_value (const Gtk3CurvePoints *p, gdouble u)
+{
+  return p->params[2] + p->params[1] * (u > 0.0 ? pow (u, p->params[0]) : 0.0);
+}
+
+/* Transfer functions are a linear or square toe below a cut and a power,
+ * log or exponential above it, or for PQ a ratio of powers throughout,
+ * with the constants of the standards. */
+#define SRGB_CUT        0.0031308
+#define SRGB_INV_CUT    0.04045
+#define REC709_CUT      0.018
+#define REC709_INV_CUT  0.081
+#define HLG_A           0.17883277
+#define HLG_B           0.28466892
+#define HLG_C           0.55991073
+#define PQ_M1           0.1593017578125
+#define PQ_M2           78.84375
+#define PQ_C1           0.8359375
+#define PQ_C2           18.8515625
+#define PQ_C3           18.6875
+
+/* v = slope u + quad u^2 for start <= i < end */
+static void
+transfer_toe (const Gtk3CurvePoints *p, gfloat slope, gfloat quad, gfloat du,
+              gint start, gint end, gfloat vector[])
+{
+  gfloat range, c[4];
+
+  range = p->max_y - p->min_y;
+  c[0] = p->min_y;
+  c[1] = range * slope;
+  c[2] = range * quad;
+  c[3] = 0.0;
+  gtk3_curve_kernels_get ()->cubic (c, 0.0, 0.0, du, p->min_y, p->max_y,
+                                    start, end, vector);
+}
+
+/* params transfer, a Gtk3CurveTransfer */
+static void
+transfer_eval_range (gpointer state, const Gtk3CurvePoints *p,
+                     gint veclen, gint start, gint end, gfloat vector[])
+{
+  const Gtk3CurveKernels *kernels;
+  gdouble r[4];
+  gfloat range, du;
+  gint mid;
+
+  kernels = gtk3_curve_kernels_get ();
+  range = p->max_y - p->min_y;
+  du = 1.0 / (veclen - 1);
+
+  switch ((gint) p->params[0])
+    {
+    default:
+    case GTK3_CURVE_TRANSFER_SRGB:
+      mid = gtk3_curve_sample_bound (0.0, du, start, end, SRGB_CUT, TRUE);
+      transfer_toe (p, 12.92, 0.0, du, start, mid, vector);
+      kernels->power (1.0 / 2.4, 1.055 * range, p->min_y - 0.055 * range,
+                      0.0, du, p->min_y, p->max_y, mid, end,
+                      vector + (mid - start));
+      break;
+
+    case GTK3_CURVE_TRANSFER_SRGB_INVERSE:
+      mid = gtk3_curve_sample_bound (0.0, du, start, end, SRGB_INV_CUT, TRUE);
+      transfer_toe (p, 1.0 / 12.92, 0.0, du, start, mid, vector);
+      kernels->power (2.4, range, p->min_y, 0.055 / 1.055, du / 1.055,
+                      p->min_y, p->max_y, mid, end,
+                      vector + (mid - start));
+      break;
+
+    case GTK3_CURVE_TRANSFER_REC709:
+      mid = gtk3_curve_sample_bound (0.0, du, start, end, REC709_CUT, FALSE);
+      transfer_toe (p, 4.5, 0.0, du, start, mid, vector);
+      kernels->power (0.45, 1.099 * range, p->min_y - 0.099 * range,
+                      0.0, du, p->min_y, p->max_y, mid, end,
+                      vector + (mid - start));
+      break;
+
+    case GTK3_CURVE_TRANSFER_REC709_INVERSE:
+      mid = gtk3_curve_sample_bound (0.0, du, start, end, REC709_INV_CUT, FALSE);
+      transfer_toe (p, 1.0 / 4.5, 0.0, du, start, mid, vector);
+      kernels->power (1.0 / 0.45, range, p->min_y, 0.099 / 1.099, du / 1.099,
+                      p->min_y, p->max_y, mid, end,
+                      vector + (mid - start));
+      break;
+
+    case GTK3_CURVE_TRANSFER_PQ:
+      /* ((c1 + c2 u^m1) / (1 + c3 u^m1))^m2 */
+      r[0] = PQ_C1;
+      r[1] = PQ_C2;
+      r[2] = 1.0;
+      r[3] = PQ_C3;
+      kernels->ratio (PQ_M1, PQ_M2, r, range, p->min_y, 0.0, du,
+                      p->min_y, p->max_y, start, end, vector);
+      break;
+
+    case GTK3_CURVE_TRANSFER_PQ_INVERSE:
+      /* (max (u^(1/m2) - c1, 0) / (c2 - c3 u^(1/m2)))^(1/m1) */
+      r[0] = -PQ_C1;
+      r[1] = 1.0;
+      r[2] = PQ_C2;
+      r[3] = -PQ_C3;
+      kernels->ratio (1.0 / PQ_M2, 1.0 / PQ_M1, r, range, p->min_y, 0.0, du,
+                      p->min_y, p->max_y, start, end, vector);
+      break;
+
+    case GTK3_CURVE_TRANSFER_HLG:
+      /* sqrt (3 u), then a ln (12 u - b) + c */
+      mid = gtk3_curve_sample_bound (0.0, du, start, end, 1.0 / 12.0, TRUE);
+      kernels->power (0.5, range, p->min_y, 0.0, 3.0 * du,
+                      p->min_y, p->max_y, start, mid, vector);
+      kernels->logarithm (HLG_A * G_LN2 * range, p->min_y + HLG_C * range,
+                          -HLG_B, 12.0 * du,
+                          p->min_y, p->max_y, mid, end,
+                          vector + (mid - start));
+      break;
+
+    case GTK3_CURVE_TRANSFER_HLG_INVERSE:
+      /* u^2 / 3, then (e^((u - c) / a) + b) / 12 */
+      mid = gtk3_curve_sample_bound (0.0, du, start, end, 0.5, TRUE);
+      transfer_toe (p, 0.0, 1.0 / 3.0, du, start, mid, vector);
+      kernels->exponential (range / 12.0, p->min_y + HLG_B / 12.0 * range,
+                            -HLG_C / (HLG_A * G_LN2), du / (HLG_A * G_LN2),
+                            p->min_y, p->max_y, mid, end,
+                            vector + (mid - start));
+      break;
+    }
+}
+
+static gdouble
+transfer_pq (gdouble u, gdouble e1, gdouble e2, const gdouble r[4])
+{
+  gdouble w;
+
+  w = u > 0.0 ? pow (u, e1) : 0.0;
+  return pow (MAX (r[0] + r[1] * w, 0.0) / (r[2] + r[3] * w), e2);
+}
+
+/* the cuts fall as in transfer_eval_range */
+static gdouble
+transfer_value (const Gtk3CurvePoints *p, gdouble u)
+{
+  static const gdouble pq[4]     = { PQ_C1, PQ_C2, 1.0, PQ_C3 };
+  static const gdouble pq_inv[4] = { -PQ_C1, 1.0, PQ_C2, -PQ_C3 };
+
+  switch ((gint) p->params[0])
+    {
+    default:
+    case GTK3_CURVE_TRANSFER_SRGB:
+      return u <= (gfloat) SRGB_CUT ? 12.92 * u : 1.055 * pow (u, 1.0 / 2.4) - 0.055;
+    case GTK3_CURVE_TRANSFER_SRGB_INVERSE:
+      return u <= (gfloat) SRGB_INV_CUT ? u / 12.92 : pow ((u + 0.055) / 1.055, 2.4);
+    case GTK3_CURVE_TRANSFER_REC709:
+      return u < (gfloat) REC709_CUT ? 4.5 * u : 1.099 * pow (u, 0.45) - 0.099;
+    case GTK3_CURVE_TRANSFER_REC709_INVERSE:
+      return u < (gfloat) REC709_INV_CUT ? u / 4.5 : pow ((u + 0.099) / 1.099, 1.0 / 0.45);
+    case GTK3_CURVE_TRANSFER_PQ:
+      return transfer_pq (u, PQ_M1, PQ_M2, pq);
+    case GTK3_CURVE_TRANSFER_PQ_INVERSE:
+      return transfer_pq (u, 1.0 / PQ_M2, 1.0 / PQ_M1, pq_inv);
+    case GTK3_CURVE_TRANSFER_HLG:
+      return u <= (gfloat) (1.0 / 12.0) ? sqrt (3.0 * u) : HLG_A * log (12.0 * u - HLG_B) + HLG_C;
+    case GTK3_CURVE_TRANSFER_HLG_INVERSE:
+      return u <= 0.5 ? u * u / 3.0 : (exp ((u - HLG_C) / HLG_A) + HLG_B) / 12.0;
+    }
+}
+
+/*                          =====================                          */
+/* ===========================    TABLE       ============================ */
+/*                          =====================                          */
+
+static const Gtk3CurveInterpolator interpolators[GTK3_CURVE_N_TYPES] =
+{
+  [GTK3_CURVE_TYPE_LINEAR] =
+    { GTK3_CURVE_TYPE_LINEAR, "linear",
+      GTK3_CURVE_INTERP_POINTS,
+      0, { 0 },
+      linear_state_new, linear_state_free,
+      linear_prepare, linear_update_local,
+      linear_eval_range, linear_eval_points,
+      linear_knots, NULL },
+  [GTK3_CURVE_TYPE_SPLINE] =
+    { GTK3_CURVE_TYPE_SPLINE, "spline",
+      GTK3_CURVE_INTERP_POINTS | GTK3_CURVE_INTERP_EDGES,
+      0, { 0 },
+      spline_state_new, spline_state_free,
+      spline_prepare, NULL,
+      spline_eval_range, spline_eval_points,
+      spline_knots, NULL },
+  [GTK3_CURVE_TYPE_FREE] =
+    { GTK3_CURVE_TYPE_FREE, "free",
+      GTK3_CURVE_INTERP_SAMPLES,
+      0, { 0 },
+      NULL, NULL,
+      NULL, NULL,
+      free_eval_range, free_eval_points,
+      NULL, NULL },
+  [GTK3_CURVE_TYPE_MONOTONE] =
+    { GTK3_CURVE_TYPE_MONOTONE, "monotone",
+      GTK3_CURVE_INTERP_POINTS | GTK3_CURVE_INTERP_EDGES,
+      0, { 0 },
+      hermite_state_new, hermite_state_free,
+      monotone_prepare, monotone_update_local,
+      hermite_eval_range, hermite_eval_points,
+      hermite_knots, NULL },
+  [GTK3_CURVE_TYPE_CATMULL_ROM] =
+    { GTK3_CURVE_TYPE_CATMULL_ROM, "catmull-rom",
+      GTK3_CURVE_INTERP_POINTS | GTK3_CURVE_INTERP_TENSION |
+      GTK3_CURVE_INTERP_EDGES,
+      0, { 0 },
+      hermite_state_new, hermite_state_free,
+      catmull_rom_prepare, catmull_rom_update_local,
+      hermite_eval_range, hermite_eval_points,
+      hermite_knots, NULL },
+  [GTK3_CURVE_TYPE_BEZIER] =
+    { GTK3_CURVE_TYPE_BEZIER, "bezier",
+      GTK3_CURVE_INTERP_POINTS | GTK3_CURVE_INTERP_HANDLES |
+      GTK3_CURVE_INTERP_TENSION | GTK3_CURVE_INTERP_EDGES,
+      0, { 0 },
+      hermite_state_new, hermite_state_free,
+      bezier_prepare, bezier_update_local,
+      hermite_eval_range, hermite_eval_points,
+      hermite_knots, NULL },
+  [GTK3_CURVE_TYPE_BSPLINE] =
+    { GTK3_CURVE_TYPE_BSPLINE, "bspline",
+      GTK3_CURVE_INTERP_POINTS | GTK3_CURVE_INTERP_EDGES,
+      0, { 0 },
+      hermite_state_new, hermite_state_free,
+      bspline_prepare, bspline_update_local,
+      hermite_eval_range, hermite_eval_points,
+      hermite_knots, NULL },
+  [GTK3_CURVE_TYPE_GAMMA] =
+    { GTK3_CURVE_TYPE_GAMMA, "gamma",
+      0,
+      1, { 1.0 },
+      NULL, NULL,
+      NULL, NULL,
+      gamma_eval_range, NULL,
+      NULL, gamma_value },
+  [GTK3_CURVE_TYPE_SIGMOID] =
+    { GTK3_CURVE_TYPE_SIGMOID, "sigmoid",
+      0,
+      2, { 10.0, 0.5 },
+      NULL, NULL,
+      NULL, NULL,
+      sigmoid_eval_range, NULL,
+      NULL, sigmoid_value },
+  [GTK3_CURVE_TYPE_LOG] =
+    { GTK3_CURVE_TYPE_LOG, "log",
+      0,
+      1, { 10.0 },
+      NULL, NULL,
+      NULL, NULL,
+      log_eval_range, NULL,
+      NULL, log_value },
+  [GTK3_CURVE_TYPE_POWER] =
+    { GTK3_CURVE_TYPE_POWER, "power",
+      0,
+      3, { 1.0, 1.0, 0.0 },
+      NULL, NULL,
+      NULL, NULL,
+      power_eval_range, NULL,
+      NULL, power_value },
+  [GTK3_CURVE_TYPE_TRANSFER] =
+    { GTK3_CURVE_TYPE_TRANSFER, "transfer",
+      0,
+      1, { GTK3_CURVE_TRANSFER_SRGB },
+      NULL, NULL,
+      NULL, NULL,
+      transfer_eval_range, NULL,
+      NULL, transfer_value },
+};
+
+/*                          =====================                          */
+/* ===========================   YE OLDE MATH   ========================== */
+/*                          =====================                          */
+
+/* Solve the tridiagonal equation system that determines the second
+   derivatives for the interpolation points.  (Based on Numerical
+   Recipies 2nd Edition.) */
+static void
+spline_solve (int n, const gfloat x[], const gfloat y[], gfloat y2[],
+              gfloat u[])
+{
+  gfloat p, sig;
+  gint i, k;
+
+  y2[0] = u[0] = 0.0; /* set lower boundary condition to "natural" */
+
+  for (i = 1; i < n - 1; ++i)
+    {
+      sig = (x[i] - x[i - 1]) / (x[i + 1] - x[i - 1]);
+      p = sig * y2[i - 1] + 2.0;
+      y2[i] = (sig - 1.0) / p;
+      u[i] = ((y[i + 1] - y[i])
+              / (x[i + 1] - x[i]) - (y[i] - y[i - 1]) / (x[i] - x[i - 1]));
+      u[i] = (6.0 * u[i] / (x[i + 1] - x[i - 1]) - sig * u[i - 1]) / p;
+    }
+
+  y2[n - 1] = 0.0;
+  for (k = n - 2; k >= 0; --k)
+    y2[k] = y2[k] * y2[k + 1] + u[k];
+}
+
+/* Rewrite the cubic of each span between x[k] and x[k + 1] as
+   c[4k] + c[4k+1] t + c[4k+2] t^2 + c[4k+3] t^3, with t = val - x[k],
+   so it can be evaluated with Horner's rule. */
+static void
+spline_coefficients (int n, const gfloat x[], const gfloat y[],
+                     const gfloat y2[], gfloat c[])
+{
+  gfloat h;
+  gint k;
+
+  for (k = 0; k < n - 1; ++k)
+    {
+      h = x[k + 1] - x[k];
+      g_assert (h > 0.0);
+
+      c[4 * k]     = y[k];
+      c[4 * k + 1] = (y[k + 1] - y[k]) / h - h * (2.0 * y2[k] + y2[k + 1]) / 6.0;
+      c[4 * k + 2] = y2[k] / 2.0;
+      c[4 * k + 3] = (y2[k + 1] - y2[k]) / (6.0 * h);
+    }
+}
+
+/* Rewrite the line of each span in the same form, c[4k] + c[4k+1] t. */
+static void
+linear_coefficients (int n, const gfloat x[], const gfloat y[], gfloat c[])
+{
+  gint k;
+
+  for (k = 0; k < n - 1; ++k)
+    {
+      c[4 * k]     = y[k];
+      c[4 * k + 1] = (y[k + 1] - y[k]) / (x[k + 1] - x[k]);
+      c[4 * k + 2] = 0.0;
+      c[4 * k + 3] = 0.0;
+    }
+}
+
+/* Tangents start <= k < end of the monotone piecewise cubic through the
+   points (Fritsch and Carlson): zero where the secants on either side
+   differ in sign, their weighted harmonic mean elsewhere, and a three
+   point estimate kept from overshooting at the ends.  Tangent k only
+   depends on the points k - 1 to k + 1, the end ones on the first or
+   last three, so each span stays between its knots. */
+static void
+monotone_tangents (int n, const gfloat x[], const gfloat y[], gfloat m[],
+                   gint start, gint end)
+{
+  gfloat h0, h1, d0, d1, w0, w1, t;
+  gint k, j;
+
+  for (k = start; k < end; ++k)
+    {
+      if (n == 2)
+        {
+          m[k] = (y[1] - y[0]) / (x[1] - x[0]);
+        }
+      else if (k == 0 || k == n - 1)
+        {
+          /* d0 is the secant of the end span, d1 that of its neighbour */
+          j = (k == 0) ? 0 : n - 2;
+          h0 = x[j + 1] - x[j];
+          d0 = (y[j + 1] - y[j]) / h0;
+          j = (k == 0) ? 1 : n - 3;
+          h1 = x[j + 1] - x[j];
+          d1 = (y[j + 1] - y[j]) / h1;
+
+          t = ((2.0 * h0 + h1) * d0 - h0 * d1) / (h0 + h1);
+          if (t * d0 <= 0.0)
+            t = 0.0;
+          else if (d0 * d1 <= 0.0 && fabs (t) > fabs (3.0 * d0))
+            t = 3.0 * d0;
+          m[k] = t;
+        }
+      else
+        {
+          h0 = x[k] - x[k - 1];
+          h1 = x[k + 1] - x[k];
+          d0 = (y[k] - y[k - 1]) / h0;
+          d1 = (y[k + 1] - y[k]) / h1;
+
+          if (d0 * d1 <= 0.0)
+            m[k] = 0.0;
+          else
+            {
+              w0 = 2.0 * h1 + h0;
+              w1 = h1 + 2.0 * h0;
+              m[k] = (w0 + w1) / (w0 / d0 + w1 / d1);
+            }
+        }
+    }
+}
+
+/* Tangents start <= k < end of the cardinal spline through the points:
+   the slope between the neighbouring points, or the end span at the
+   ends, scaled by 1 - tension.  Tension 0 is Catmull-Rom. */
+static void
+cardinal_tangents (int n, const gfloat x[], const gfloat y[], gfloat tension,
+                   gfloat m[], gint start, gint end)
+{
+  gint k, lo, hi;
+
+  for (k = start; k < end; ++k)
+    {
+      lo = MAX (k - 1, 0);
+      hi = MIN (k + 1, n - 1);
+      m[k] = (1.0 - tension) * (y[hi] - y[lo]) / (x[hi] - x[lo]);
+    }
+}
+
+/* Replaces the tangents start <= k < end by the slopes of the Bezier
+   handles, l into and r out of the point, where they are set (not NAN):
+   nt[k] is the tangent into point k, m[k] the one out of it. */
+static void
+bezier_tangents (const gfloat l[], const gfloat r[], gfloat m[], gfloat nt[],
+                 gint start, gint end)
+{
+  gint k;
+
+  for (k = start; k < end; ++k)
+    {
+      nt[k] = isnan (l[k]) ? m[k] : l[k];
+      if (!isnan (r[k]))
+        m[k] = r[k];
+    }
+}
+
+/* Knot values start <= k < end of the uniform cubic B-spline with
+   control values y, (y[k - 1] + 4 y[k] + y[k + 1]) / 6, with the end
+   points mirrored so the curve starts and ends on them.  Together with
+   the Catmull-Rom tangents, which are the B-spline derivatives, they
+   give the B-spline in Hermite form. */
+static void
+bspline_values (int n, const gfloat y[], gfloat s[], gint start, gint end)
+{
+  gint k;
+
+  for (k = start; k < end; ++k)
+    {
+      if (k == 0 || k == n - 1)
+        s[k] = y[k];
+      else
+        s[k] = (y[k - 1] + 4.0 * y[k] + y[k + 1]) / 6.0;
+    }
+}
+
+/* Rewrite the cubic Hermite span between x[k] and x[k + 1], with tangent
+   m[k] out of the first knot and nt[k + 1] into the second, in the same
+   form as the spline. */
+static void
+hermite_coefficients (int n, const gfloat x[], const gfloat y[],
+                      const gfloat m[], const gfloat nt[], gfloat c[])
+{
+  gfloat h, d;
+  gint k;
+
+  for (k = 0; k < n - 1; ++k)
+    {
+      h = x[k + 1] - x[k];
+      d = (y[k + 1] - y[k]) / h;
+
+      c[4 * k]     = y[k];
+      c[4 * k + 1] = m[k];
+      c[4 * k + 2] = (3.0 * d - 2.0 * m[k] - nt[k + 1]) / h;
+      c[4 * k + 3] = (m[k] + nt[k + 1] - 2.0 * d) / (h * h);
+    }
+}
+
+/* Index k of the span x[k] <= val < x[k + 1], clamped to the first and
+   last span. */
+static gint
+span_find (int n, const gfloat x[], gfloat val)
+{
+  gint k_lo, k_hi, k;
+
+  k_lo = 0;
+  k_hi = n - 1;
+  while (k_hi - k_lo > 1)
+    {
+      k = (k_hi + k_lo) / 2;
+      if (x[k] > val)
+        k_hi = k;
+      else
+        k_lo = k;
+    }
+
+  return k_lo;
+}
+
+/* The values left of the first and right of the last knot, unless edge
+   extends the spans. */
+static void
+piecewise_edges (int n, const gfloat x[], const gfloat c[], Edge edge,
+                 gfloat min_y, gfloat max_y, gfloat *first, gfloat *last)
+{
+  const gfloat *l;
+  gfloat t;
+
+  *first = *last = min_y;
+  if (edge == EDGE_HOLD)
+    {
+      l = c + 4 * (n - 2);
+      t = x[n - 1] - x[n - 2];
+      *first = CLAMP (c[0], min_y, max_y);
+      *last = CLAMP (((l[3] * t + l[2]) * t + l[1]) * t + l[0], min_y, max_y);
+    }
+}
+
+/* Evaluate a piecewise cubic at the positions x0 + i * dx, start <= i <
+   end, and clamp the result.  The positions increase, so the range is cut
+   into runs of samples sharing a span and each run is handed to the cubic
+   kernel.  Positions outside the knots are filled as edge says. */
+static void
+piecewise_eval (int n, const gfloat x[], const gfloat c[], Edge edge,
+                gfloat x0, gfloat dx,
+                gfloat min_y, gfloat max_y,
+                gint start, gint end, gfloat vector[])
+{
+  const Gtk3CurveKernels *kernels;
+  gfloat first, last;
+  gint i, k, stop;
+
+  kernels = gtk3_curve_kernels_get ();
+
+  piecewise_edges (n, x, c, edge, min_y, max_y, &first, &last);
+
+  if (!(dx > 0.0))
+    {
+      /* empty or reversed range, no runs to find */
+      for (i = start; i < end; ++i)
+        {
+          gfloat rx = x0 + (gfloat) i * dx;
+
+          if (edge != EDGE_EXTEND && rx < x[0])
+            vector[i - start] = first;
+          else if (edge != EDGE_EXTEND && rx > x[n - 1])
+            vector[i - start] = last;
+          else
+            {
+              k = span_find (n, x, rx);
+              kernels->cubic (c + 4 * k, x[k], x0, dx, min_y, max_y,
+                              i, i + 1, vector + (i - start));
+            }
+        }
+      return;
+    }
+
+  i = start;
+  if (edge != EDGE_EXTEND)
+    {
+      stop = gtk3_curve_sample_bound (x0, dx, i, end, x[0], FALSE);
+      for (; i < stop; ++i)
+        vector[i - start] = first;
+    }
+
+  if (i < end)
+    k = span_find (n, x, x0 + (gfloat) i * dx);
+  else
+    k = n - 1;
+
+  for (; k < n - 1 && i < end; ++k)
+    {
+      if (k < n - 2)
+        stop = gtk3_curve_sample_bound (x0, dx, i, end, x[k + 1], FALSE);
+      else if (edge == EDGE_EXTEND)
+        stop = end;
+      else
+        stop = gtk3_curve_sample_bound (x0, dx, i, end, x[k + 1], TRUE);
+
+      kernels->cubic (c + 4 * k, x[k], x0, dx, min_y, max_y,
+                      i, stop, vector + (i - start));
+      i = stop;
+    }
+
+  for (; i < end; ++i)
+    vector[i - start] = last;
+}
+
+/* piecewise_eval at the positions px[j], j < n_points.  When they are
+   sorted only the first is found with span_find and the spans are walked
+   along with the rest, otherwise each is searched for; a position goes
+   to the same span either way, and is evaluated as the cubic kernel
+   would. */
+static void
+piecewise_points (int n, const gfloat x[], const gfloat c[], Edge edge,
+                  gfloat min_y, gfloat max_y,
+                  const gfloat px[], gfloat py[], gint n_points,
+                  gboolean sorted)
+{
+  const gfloat *l;
+  gfloat first, last, t, ry;
+  gint j, k;
+
+  piecewise_edges (n, x, c, edge, min_y, max_y, &first, &last);
+
+  k = sorted && n_points > 0 ? span_find (n, x, px[0]) : 0;
+  for (j = 0; j < n_points; ++j)
+    {
+      if (edge != EDGE_EXTEND && px[j] < x[0])
+        {
+          py[j] = first;
+          continue;
+        }
+      if (edge != EDGE_EXTEND && px[j] > x[n - 1])
+        {
+          py[j] = last;
+          continue;
+        }
+
+      if (sorted)
+        {
+          while (k < n - 2 && px[j] >= x[k + 1])
+            ++k;
+        }
+      else
+        k = span_find (n, x, px[j]);
+
+      l = c + 4 * k;
+      t = px[j] - x[k];
+      ry = ((l[3] * t + l[2]) * t + l[1]) * t + l[0];
+      ry = MAX (ry, min_y);
+      ry = MIN (ry, max_y);
+      py[j] = ry;
+    }
+}
+
+/*                          =====================                           */
+/* =========================== PUBLIC FUNCTIONS =========================== */
+/*                          =====================                           */
+
+const Gtk3CurveInterpolator *
+gtk3_curve_interpolator_get (Gtk3CurveType type)
+{
+  g_return_val_if_fail (type >= 0 && type < GTK3_CURVE_N_TYPES,
+                        &interpolators[GTK3_CURVE_TYPE_SPLINE]);
+
+  return &interpolators[type];
+}
+
+/* First index i >= start whose position x0 + i * dx reaches limit (or
+   passes it when inclusive), veclen if none does.  dx must be positive.
+   The position is computed exactly as the kernels do, so a sample is
+   never assigned to a span it does not belong to. */
+gint
+gtk3_curve_sample_bound (gfloat x0, gfloat dx, gint start, gint veclen,
+                         gfloat limit, gboolean inclusive)
+{
+  gdouble guess;
+  gint i;
+
+#define BEFORE(i) (inclusive ? (x0 + (gfloat) (i) * dx) <= limit \
+                             : (x0 + (gfloat) (i) * dx) <  limit)
+
+  guess = ceil ((limit - x0) / (gdouble) dx);
+  i = CLAMP (guess, start, veclen);
+
+  while (i > start && !BEFORE (i - 1))
+    --i;
+  while (i < veclen && BEFORE (i))
+    ++i;
+
+#undef BEFORE
+
+  return i;
+}
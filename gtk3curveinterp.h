@@ -0,0 +1,158 @@
+/* Copyright (C) 2016 Benoit Touchette
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation version
+ * 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Private header, not installed. */
+
+#ifndef __GTK3_CURVE_INTERP__H__
+#define __GTK3_CURVE_INTERP__H__
+
+#include <glib.h>
+
+#include "gtk3curvemodel.h"
+
+#define GTK3_CURVE_N_TYPES   (GTK3_CURVE_TYPE_TRANSFER + 1)
+#define GTK3_CURVE_N_PARAMS  4
+
+/* eval_range of an analytic type is within this much of the y range of
+ * its value */
+#define GTK3_CURVE_ANALYTIC_ERROR  (1.0 / (1 << 18))
+
+typedef struct _Gtk3CurvePoints        Gtk3CurvePoints;
+typedef struct _Gtk3CurveKnots         Gtk3CurveKnots;
+typedef struct _Gtk3CurveInterpolator  Gtk3CurveInterpolator;
+
+typedef enum
+{
+  /* edited by dragging control points, found by their x; without it the
+   * curve is drawn freehand and has no points to hit */
+  GTK3_CURVE_INTERP_POINTS  = 1 << 0,
+  /* reads the Bezier handles of the points */
+  GTK3_CURVE_INTERP_HANDLES = 1 << 1,
+  /* reads the tension */
+  GTK3_CURVE_INTERP_TENSION = 1 << 2,
+  /* values outside the knots follow the end spans */
+  GTK3_CURVE_INTERP_EDGES   = 1 << 3,
+  /* evaluates the free form samples */
+  GTK3_CURVE_INTERP_SAMPLES = 1 << 4
+} Gtk3CurveInterpFlags;
+
+/* What an interpolator evaluates: the active control points, with
+ * increasing x, the free form samples or the parameters of its type,
+ * and the range. */
+struct _Gtk3CurvePoints
+{
+  gint n;
+  const gfloat *x;
+  const gfloat *y;
+  const gfloat *l;              /* handle slopes into and out of the */
+  const gfloat *r;              /* points, NAN when automatic */
+  gfloat tension;
+
+  gint n_samples;
+  const gfloat *samples;
+
+  const gfloat *params;
+
+  gfloat min_x;
+  gfloat max_x;
+  gfloat min_y;
+  gfloat max_y;
+};
+
+/* The knot values and the derivatives out of (d_out) and into (d_in)
+ * each knot that the spans are built from.  Span k, h wide, changes by
+ * at most the larger change of its two knot values plus (|change of
+ * d_out[k]| + |change of d_in[k + 1]|) * h^order * weight.  The
+ * derivatives are NULL when the spans only depend on the values. */
+struct _Gtk3CurveKnots
+{
+  const gfloat *value;
+  const gfloat *d_out;
+  const gfloat *d_in;
+  gint order;
+  gfloat weight;
+};
+
+/* One curve type.  Its state holds what it precomputes from the points;
+ * the model keeps one per type and prepares it again when the points
+ * changed.  Functions taking points are called with at least two.
+ * Types without points or samples are analytic, defined by n_params
+ * parameters that start out as params. */
+struct _Gtk3CurveInterpolator
+{
+  Gtk3CurveType type;
+  const gchar *name;
+  Gtk3CurveInterpFlags flags;
+  gint n_params;
+  gfloat params[GTK3_CURVE_N_PARAMS];
+
+  gpointer (* state_new)    (void);
+  void     (* state_free)   (gpointer               state);
+
+  /* precomputes the state from the points, NULL if there is none */
+  void     (* prepare)      (gpointer               state,
+                             const Gtk3CurvePoints *points);
+
+  /* updates the state after point i moved, or its handles changed,
+   * without reordering the points, only as far as that reaches; NULL if
+   * every change needs prepare */
+  void     (* update_local) (gpointer               state,
+                             const Gtk3CurvePoints *points,
+                             gint                   i);
+
+  /* samples start <= i < end of a veclen vector evenly spaced over
+   * [min_x, max_x] into vector[i - start], clamped to [min_y, max_y];
+   * only reads the state, so ranges may be evaluated in parallel */
+  void     (* eval_range)   (gpointer               state,
+                             const Gtk3CurvePoints *points,
+                             gint                   veclen,
+                             gint                   start,
+                             gint                   end,
+                             gfloat                 vector[]);
+
+  /* y[j] at x[j] for 0 <= j < n, clamped as eval_range, which the
+   * piecewise types match at its positions; sorted when x never
+   * decreases, so the spans can be walked once instead of searched for
+   * each x.  NULL for the analytic types, evaluated from value. */
+  void     (* eval_points)  (gpointer               state,
+                             const Gtk3CurvePoints *points,
+                             const gfloat           x[],
+                             gfloat                 y[],
+                             gint                   n,
+                             gboolean               sorted);
+
+  /* the knots of the prepared state, for change tracking */
+  void     (* knots)        (gpointer               state,
+                             const Gtk3CurvePoints *points,
+                             Gtk3CurveKnots        *knots);
+
+  /* an analytic type's v, 0 at min_y and 1 at max_y, at u, 0 at min_x
+   * and 1 at max_x, computed in double and not clamped; for rounding to
+   * code values where eval_range is too close to call */
+  gdouble  (* value)        (const Gtk3CurvePoints *points,
+                             gdouble                u);
+};
+
+const Gtk3CurveInterpolator *gtk3_curve_interpolator_get (Gtk3CurveType type);
+
+gint gtk3_curve_sample_bound                      (gfloat             x0,
+                                                   gfloat             dx,
+                                                   gint               start,
+                                                   gint               veclen,
+                                                   gfloat             limit,
+                                                   gboolean           inclusive);
+
+#endif /* __GTK3_CURVE_INTERP__H__ */
@@ -0,0 +1,1397 @@
+/* Copyright (C) 2016 Benoit Touchette
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation version
+ * 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Evaluation kernels.  The portable versions are plain C; on x86 with
+ * GCC or clang SSE2 and AVX2 versions are compiled with target attributes
+ * (no special compiler flags needed) and picked at run time from what the
+ * CPU supports.  The vector versions perform the same float operations in
+ * the same order as the portable ones, so results do not depend on the
+ * machine.
+ */
+
+#include <glib.h>
+
+#include "gtk3curvekernels.h"
+
+#ifdef DEBUG
+#define DEBUG_INFO g_print
+#define DEBUG_ERROR g_printerr
+#else
+#define DEBUG_INFO(...)
+#define DEBUG_ERROR(...)
+#endif
+
+#if (defined (__GNUC__) || defined (__clang__)) && (defined (__x86_64__) || defined (__i386__))
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/*                          =====================                          */
+/* ===========================    PORTABLE    ============================ */
+/*                          =====================                          */
+
+static void
+cubic_c (const gfloat c[4], gfloat xk, gfloat x0, gfloat dx,
+         gfloat min_y, gfloat max_y,
+         gint start, gint end, gfloat *vector)
+{
+  gfloat t, ry;
+  gint i;
+
+  for (i = start; i < end; ++i)
+    {
+      t  = (x0 + (gfloat) i * dx) - xk;
+      ry = ((c[3] * t + c[2]) * t + c[1]) * t + c[0];
+      ry = MAX (ry, min_y);
+      ry = MIN (ry, max_y);
+      vector[i - start] = ry;
+    }
+}
+
+static void
+resample_c (const gfloat *samples, gint n_samples, gint veclen,
+            gint start, gint end, gfloat *vector)
+{
+  gint i;
+
+  for (i = start; i < end; ++i)
+    vector[i - start] = samples[(gint64) i * n_samples / veclen];
+}
+
+static void
+project_c (const gfloat *vector, gint n, gfloat min, gfloat scale,
+           gint x0, gint y0, gint *point)
+{
+  gint i;
+
+  for (i = 0; i < n; ++i)
+    {
+      point[2 * i]     = x0 + i;
+      point[2 * i + 1] = y0 - (gint) ((vector[i] - min) * scale + 0.5f);
+    }
+}
+
+#define QUANTIZE_C(vector, i, min, scale, max_code)                         \
+  ((gint) MIN (MAX (((vector)[i] - (min)) * (scale) + 0.5f, 0.0f),          \
+               (gfloat) (max_code)))
+
+static void
+quantize_u8_c (const gfloat *vector, gint n, gfloat min, gfloat scale,
+               gint max_code, guint8 *code)
+{
+  gint i;
+
+  for (i = 0; i < n; ++i)
+    code[i] = QUANTIZE_C (vector, i, min, scale, max_code);
+}
+
+static void
+quantize_u16_c (const gfloat *vector, gint n, gfloat min, gfloat scale,
+                gint max_code, guint16 *code)
+{
+  gint i;
+
+  for (i = 0; i < n; ++i)
+    code[i] = QUANTIZE_C (vector, i, min, scale, max_code);
+}
+
+/* log2 (m) for sqrt(1/2) <= m <= sqrt(2) is 2/ln(2) atanh (s) with
+ * s = (m - 1) / (m + 1), |s| <= 0.172; the series is cut after s^7 */
+#define LOG2_C1  2.885390082f
+#define LOG2_C3  0.961796694f
+#define LOG2_C5  0.577078016f
+#define LOG2_C7  0.412198583f
+
+/* 2^f for 0 <= f < 1, interpolated at the Chebyshev nodes */
+#define EXP2_C0  1.0f
+#define EXP2_C1  0.6931469328f
+#define EXP2_C2  0.2402304544f
+#define EXP2_C3  0.05548063020f
+#define EXP2_C4  0.009684186310f
+#define EXP2_C5  0.001239133183f
+#define EXP2_C6  0.0002186578479f
+
+#define SQRT2_F  1.41421356f
+#define MIN_F    1.17549435e-38f    /* smallest normal float */
+
+typedef union
+{
+  gfloat f;
+  gint32 i;
+} FloatBits;
+
+/* t = 2^e m with 1 <= m < 2, then m halved if above sqrt(2) */
+static inline gfloat
+log2_c (gfloat t)
+{
+  FloatBits u;
+  gfloat e, m, s, s2;
+
+  u.f = MAX (t, MIN_F);
+  e = (gfloat) ((u.i >> 23) - 127);
+  u.i = (u.i & 0x007fffff) | 0x3f800000;
+  m = u.f;
+  if (m > SQRT2_F)
+    {
+      m = m * 0.5f;
+      e = e + 1.0f;
+    }
+
+  s  = (m - 1.0f) / (m + 1.0f);
+  s2 = s * s;
+  return e + s * (((LOG2_C7 * s2 + LOG2_C5) * s2 + LOG2_C3) * s2 + LOG2_C1);
+}
+
+/* t = n + f with integer n, 2^n built from its bits */
+static inline gfloat
+exp2_c (gfloat t)
+{
+  FloatBits u;
+  gfloat n, f, p;
+
+  t = MAX (t, -126.0f);
+  t = MIN (t, 127.0f);
+  n = (gfloat) (gint) t;
+  if (t < n)
+    n = n - 1.0f;
+  f = t - n;
+
+  p = (((((EXP2_C6 * f + EXP2_C5) * f + EXP2_C4) * f + EXP2_C3) * f
+        + EXP2_C2) * f + EXP2_C1) * f + EXP2_C0;
+  u.i = ((gint) n + 127) << 23;
+  return p * u.f;
+}
+
+/* t^e, 0 for t <= 0 */
+static inline gfloat
+pow_c (gfloat t, gfloat e)
+{
+  return t > 0.0f ? exp2_c (e * log2_c (t)) : 0.0f;
+}
+
+static void
+power_c (gfloat e, gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+         gfloat min_y, gfloat max_y,
+         gint start, gint end, gfloat *vector)
+{
+  gfloat ry;
+  gint i;
+
+  for (i = start; i < end; ++i)
+    {
+      ry = offset + scale * pow_c (x0 + (gfloat) i * dx, e);
+      ry = MAX (ry, min_y);
+      ry = MIN (ry, max_y);
+      vector[i - start] = ry;
+    }
+}
+
+static void
+logarithm_c (gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+             gfloat min_y, gfloat max_y,
+             gint start, gint end, gfloat *vector)
+{
+  gfloat ry;
+  gint i;
+
+  for (i = start; i < end; ++i)
+    {
+      ry = offset + scale * log2_c (x0 + (gfloat) i * dx);
+      ry = MAX (ry, min_y);
+      ry = MIN (ry, max_y);
+      vector[i - start] = ry;
+    }
+}
+
+static void
+logistic_c (gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+            gfloat min_y, gfloat max_y,
+            gint start, gint end, gfloat *vector)
+{
+  gfloat ry;
+  gint i;
+
+  for (i = start; i < end; ++i)
+    {
+      ry = offset + scale / (1.0f + exp2_c (x0 + (gfloat) i * dx));
+      ry = MAX (ry, min_y);
+      ry = MIN (ry, max_y);
+      vector[i - start] = ry;
+    }
+}
+
+static void
+exponential_c (gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+               gfloat min_y, gfloat max_y,
+               gint start, gint end, gfloat *vector)
+{
+  gfloat ry;
+  gint i;
+
+  for (i = start; i < end; ++i)
+    {
+      ry = offset + scale * exp2_c (x0 + (gfloat) i * dx);
+      ry = MAX (ry, min_y);
+      ry = MIN (ry, max_y);
+      vector[i - start] = ry;
+    }
+}
+
+/* log2_c and exp2_c in double, for the ratio kernel: its large exponents
+ * would magnify float rounding beyond the bounds.  The series is cut
+ * after s^15, 2^f is of degree 11; both are within a few ulp. */
+#define LOG2_D1   2.88539008177792677
+#define LOG2_D3   0.961796693925975554
+#define LOG2_D5   0.577078016355585310
+#define LOG2_D7   0.412198583111132388
+#define LOG2_D9   0.320598897975325203
+#define LOG2_D11  0.262308189252538793
+#define LOG2_D13  0.221953083213686675
+#define LOG2_D15  0.192359338785195122
+
+#define EXP2_D0   1.0
+#define EXP2_D1   0.693147180559946512
+#define EXP2_D2   0.240226506959043178
+#define EXP2_D3   0.0555041086658961425
+#define EXP2_D4   0.00961812909727945796
+#define EXP2_D5   0.00133335587335299921
+#define EXP2_D6   0.000154035093187626299
+#define EXP2_D7   0.0000152532305747014774
+#define EXP2_D8   0.00000132077033444219251
+#define EXP2_D9   0.000000102581516099685676
+#define EXP2_D10  0.00000000653874113087425982
+#define EXP2_D11  0.000000000630127709581262046
+
+#define SQRT2_D   1.4142135623730951
+#define MIN_D     2.2250738585072014e-308   /* smallest normal double */
+
+typedef union
+{
+  gdouble f;
+  gint64 i;
+} DoubleBits;
+
+static inline gdouble
+log2_d (gdouble t)
+{
+  DoubleBits u;
+  gdouble e, m, s, s2, p;
+
+  u.f = MAX (t, MIN_D);
+  e = (gdouble) ((u.i >> 52) - 1023);
+  u.i = (u.i & G_GINT64_CONSTANT (0x000fffffffffffff)) |
+        G_GINT64_CONSTANT (0x3ff0000000000000);
+  m = u.f;
+  if (m > SQRT2_D)
+    {
+      m = m * 0.5;
+      e = e + 1.0;
+    }
+
+  s  = (m - 1.0) / (m + 1.0);
+  s2 = s * s;
+  p  = ((LOG2_D15 * s2 + LOG2_D13) * s2 + LOG2_D11) * s2 + LOG2_D9;
+  p  = ((p * s2 + LOG2_D7) * s2 + LOG2_D5) * s2 + LOG2_D3;
+  return e + s * (p * s2 + LOG2_D1);
+}
+
+static inline gdouble
+exp2_d (gdouble t)
+{
+  DoubleBits u;
+  gdouble n, f, p;
+
+  t = MAX (t, -1022.0);
+  t = MIN (t, 1023.0);
+  n = (gdouble) (gint) t;
+  if (t < n)
+    n = n - 1.0;
+  f = t - n;
+
+  p = ((EXP2_D11 * f + EXP2_D10) * f + EXP2_D9) * f + EXP2_D8;
+  p = ((p * f + EXP2_D7) * f + EXP2_D6) * f + EXP2_D5;
+  p = ((p * f + EXP2_D4) * f + EXP2_D3) * f + EXP2_D2;
+  p = (p * f + EXP2_D1) * f + EXP2_D0;
+  u.i = ((gint64) n + 1023) << 52;
+  return p * u.f;
+}
+
+static inline gdouble
+pow_d (gdouble t, gdouble e)
+{
+  return t > 0.0 ? exp2_d (e * log2_d (t)) : 0.0;
+}
+
+static void
+ratio_c (gdouble e1, gdouble e2, const gdouble r[4],
+         gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+         gfloat min_y, gfloat max_y,
+         gint start, gint end, gfloat *vector)
+{
+  gdouble w, q;
+  gfloat ry;
+  gint i;
+
+  for (i = start; i < end; ++i)
+    {
+      w  = pow_d (x0 + (gfloat) i * dx, e1);
+      q  = MAX (r[0] + r[1] * w, 0.0) / (r[2] + r[3] * w);
+      ry = offset + scale * pow_d (q, e2);
+      ry = MAX (ry, min_y);
+      ry = MIN (ry, max_y);
+      vector[i - start] = ry;
+    }
+}
+
+static const Gtk3CurveKernels kernels_c =
+{
+  "c",
+  cubic_c,
+  resample_c,
+  project_c,
+  quantize_u8_c,
+  quantize_u16_c,
+  power_c,
+  logarithm_c,
+  logistic_c,
+  exponential_c,
+  ratio_c
+};
+
+#ifdef HAVE_X86_KERNELS
+
+/*                          =====================                          */
+/* ===========================      SSE2      ============================ */
+/*                          =====================                          */
+
+__attribute__ ((target ("sse2")))
+static inline __m128
+cubic_sse2_4 (__m128 vi, __m128 c0, __m128 c1, __m128 c2, __m128 c3,
+              __m128 vxk, __m128 vx0, __m128 vdx, __m128 vmin, __m128 vmax)
+{
+  __m128 t, ry;
+
+  t  = _mm_sub_ps (_mm_add_ps (vx0, _mm_mul_ps (vi, vdx)), vxk);
+  ry = _mm_add_ps (_mm_mul_ps (c3, t), c2);
+  ry = _mm_add_ps (_mm_mul_ps (ry, t), c1);
+  ry = _mm_add_ps (_mm_mul_ps (ry, t), c0);
+  return _mm_min_ps (_mm_max_ps (ry, vmin), vmax);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+cubic_sse2 (const gfloat c[4], gfloat xk, gfloat x0, gfloat dx,
+            gfloat min_y, gfloat max_y,
+            gint start, gint end, gfloat *vector)
+{
+  __m128 c0, c1, c2, c3, vxk, vx0, vdx, vmin, vmax, vi, four;
+  gint i;
+
+  c0   = _mm_set1_ps (c[0]);
+  c1   = _mm_set1_ps (c[1]);
+  c2   = _mm_set1_ps (c[2]);
+  c3   = _mm_set1_ps (c[3]);
+  vxk  = _mm_set1_ps (xk);
+  vx0  = _mm_set1_ps (x0);
+  vdx  = _mm_set1_ps (dx);
+  vmin = _mm_set1_ps (min_y);
+  vmax = _mm_set1_ps (max_y);
+  four = _mm_set1_ps (4.0f);
+
+  /* indices stay exact in float up to 2^24 */
+  vi = _mm_cvtepi32_ps (_mm_add_epi32 (_mm_set1_epi32 (start),
+                                       _mm_setr_epi32 (0, 1, 2, 3)));
+  for (i = start; i + 8 <= end; i += 8)
+    {
+      _mm_storeu_ps (vector + (i - start),
+                     cubic_sse2_4 (vi, c0, c1, c2, c3, vxk, vx0, vdx, vmin, vmax));
+      vi = _mm_add_ps (vi, four);
+      _mm_storeu_ps (vector + (i - start) + 4,
+                     cubic_sse2_4 (vi, c0, c1, c2, c3, vxk, vx0, vdx, vmin, vmax));
+      vi = _mm_add_ps (vi, four);
+    }
+
+  cubic_c (c, xk, x0, dx, min_y, max_y, i, end, vector + (i - start));
+}
+
+__attribute__ ((target ("sse2")))
+static void
+project_sse2 (const gfloat *vector, gint n, gfloat min, gfloat scale,
+              gint x0, gint y0, gint *point)
+{
+  __m128 vmin, vscale, half;
+  __m128i vx, vy0, four, y;
+  gint i;
+
+  vmin   = _mm_set1_ps (min);
+  vscale = _mm_set1_ps (scale);
+  half   = _mm_set1_ps (0.5f);
+  vy0    = _mm_set1_epi32 (y0);
+  four   = _mm_set1_epi32 (4);
+  vx     = _mm_setr_epi32 (x0, x0 + 1, x0 + 2, x0 + 3);
+
+  for (i = 0; i + 4 <= n; i += 4)
+    {
+      y = _mm_cvttps_epi32 (_mm_add_ps (_mm_mul_ps (_mm_sub_ps (_mm_loadu_ps (vector + i),
+                                                                vmin),
+                                                    vscale),
+                                        half));
+      y = _mm_sub_epi32 (vy0, y);
+      _mm_storeu_si128 ((__m128i *) (point + 2 * i),     _mm_unpacklo_epi32 (vx, y));
+      _mm_storeu_si128 ((__m128i *) (point + 2 * i + 4), _mm_unpackhi_epi32 (vx, y));
+      vx = _mm_add_epi32 (vx, four);
+    }
+
+  project_c (vector + i, n - i, min, scale, x0 + i, y0, point + 2 * i);
+}
+
+/* four code values of QUANTIZE_C, as 32 bit integers */
+__attribute__ ((target ("sse2")))
+static inline __m128i
+quantize_sse2_4 (const gfloat *vector, __m128 vmin, __m128 vscale,
+                 __m128 vmax)
+{
+  __m128 r;
+
+  r = _mm_add_ps (_mm_mul_ps (_mm_sub_ps (_mm_loadu_ps (vector), vmin), vscale),
+                  _mm_set1_ps (0.5f));
+  r = _mm_min_ps (_mm_max_ps (r, _mm_setzero_ps ()), vmax);
+  return _mm_cvttps_epi32 (r);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+quantize_u8_sse2 (const gfloat *vector, gint n, gfloat min, gfloat scale,
+                  gint max_code, guint8 *code)
+{
+  __m128 vmin, vscale, vmax;
+  __m128i a, b, c, d;
+  gint i;
+
+  vmin   = _mm_set1_ps (min);
+  vscale = _mm_set1_ps (scale);
+  vmax   = _mm_set1_ps (max_code);
+
+  for (i = 0; i + 16 <= n; i += 16)
+    {
+      a = quantize_sse2_4 (vector + i,      vmin, vscale, vmax);
+      b = quantize_sse2_4 (vector + i + 4,  vmin, vscale, vmax);
+      c = quantize_sse2_4 (vector + i + 8,  vmin, vscale, vmax);
+      d = quantize_sse2_4 (vector + i + 12, vmin, vscale, vmax);
+      _mm_storeu_si128 ((__m128i *) (code + i),
+                        _mm_packus_epi16 (_mm_packs_epi32 (a, b),
+                                          _mm_packs_epi32 (c, d)));
+    }
+
+  quantize_u8_c (vector + i, n - i, min, scale, max_code, code + i);
+}
+
+__attribute__ ((target ("sse2")))
+static void
+quantize_u16_sse2 (const gfloat *vector, gint n, gfloat min, gfloat scale,
+                   gint max_code, guint16 *code)
+{
+  __m128 vmin, vscale, vmax;
+  __m128i a, b, bias;
+  gint i;
+
+  vmin   = _mm_set1_ps (min);
+  vscale = _mm_set1_ps (scale);
+  vmax   = _mm_set1_ps (max_code);
+  bias   = _mm_set1_epi32 (32768);
+
+  /* SSE2 only packs signed, so shift to it and back */
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      a = _mm_sub_epi32 (quantize_sse2_4 (vector + i,     vmin, vscale, vmax), bias);
+      b = _mm_sub_epi32 (quantize_sse2_4 (vector + i + 4, vmin, vscale, vmax), bias);
+      _mm_storeu_si128 ((__m128i *) (code + i),
+                        _mm_xor_si128 (_mm_packs_epi32 (a, b),
+                                       _mm_set1_epi16 ((gint16) 0x8000)));
+    }
+
+  quantize_u16_c (vector + i, n - i, min, scale, max_code, code + i);
+}
+
+/* log2_c with the branch turned into masks; halving or not, and adding
+ * one or zero, give the same floats either way */
+__attribute__ ((target ("sse2")))
+static inline __m128
+log2_sse2 (__m128 t)
+{
+  __m128i bits;
+  __m128 e, m, big, one, s, s2, p;
+
+  one  = _mm_set1_ps (1.0f);
+  bits = _mm_castps_si128 (_mm_max_ps (t, _mm_set1_ps (MIN_F)));
+  e    = _mm_cvtepi32_ps (_mm_sub_epi32 (_mm_srli_epi32 (bits, 23),
+                                         _mm_set1_epi32 (127)));
+  m    = _mm_castsi128_ps (_mm_or_si128 (_mm_and_si128 (bits, _mm_set1_epi32 (0x007fffff)),
+                                         _mm_set1_epi32 (0x3f800000)));
+  big  = _mm_cmpgt_ps (m, _mm_set1_ps (SQRT2_F));
+  m    = _mm_mul_ps (m, _mm_or_ps (_mm_and_ps (big, _mm_set1_ps (0.5f)),
+                                   _mm_andnot_ps (big, one)));
+  e    = _mm_add_ps (e, _mm_and_ps (big, one));
+
+  s  = _mm_div_ps (_mm_sub_ps (m, one), _mm_add_ps (m, one));
+  s2 = _mm_mul_ps (s, s);
+  p  = _mm_add_ps (_mm_mul_ps (_mm_set1_ps (LOG2_C7), s2), _mm_set1_ps (LOG2_C5));
+  p  = _mm_add_ps (_mm_mul_ps (p, s2), _mm_set1_ps (LOG2_C3));
+  p  = _mm_add_ps (_mm_mul_ps (p, s2), _mm_set1_ps (LOG2_C1));
+  return _mm_add_ps (e, _mm_mul_ps (s, p));
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128
+exp2_sse2 (__m128 t)
+{
+  __m128 n, f, p;
+
+  t = _mm_max_ps (t, _mm_set1_ps (-126.0f));
+  t = _mm_min_ps (t, _mm_set1_ps (127.0f));
+  n = _mm_cvtepi32_ps (_mm_cvttps_epi32 (t));
+  n = _mm_sub_ps (n, _mm_and_ps (_mm_cmplt_ps (t, n), _mm_set1_ps (1.0f)));
+  f = _mm_sub_ps (t, n);
+
+  p = _mm_add_ps (_mm_mul_ps (_mm_set1_ps (EXP2_C6), f), _mm_set1_ps (EXP2_C5));
+  p = _mm_add_ps (_mm_mul_ps (p, f), _mm_set1_ps (EXP2_C4));
+  p = _mm_add_ps (_mm_mul_ps (p, f), _mm_set1_ps (EXP2_C3));
+  p = _mm_add_ps (_mm_mul_ps (p, f), _mm_set1_ps (EXP2_C2));
+  p = _mm_add_ps (_mm_mul_ps (p, f), _mm_set1_ps (EXP2_C1));
+  p = _mm_add_ps (_mm_mul_ps (p, f), _mm_set1_ps (EXP2_C0));
+  return _mm_mul_ps (p, _mm_castsi128_ps (_mm_slli_epi32 (_mm_add_epi32 (_mm_cvttps_epi32 (n),
+                                                                        _mm_set1_epi32 (127)),
+                                                          23)));
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128
+pow_sse2 (__m128 t, __m128 e)
+{
+  return _mm_and_ps (_mm_cmpgt_ps (t, _mm_setzero_ps ()),
+                     exp2_sse2 (_mm_mul_ps (e, log2_sse2 (t))));
+}
+
+__attribute__ ((target ("sse2")))
+static void
+power_sse2 (gfloat e, gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+            gfloat min_y, gfloat max_y,
+            gint start, gint end, gfloat *vector)
+{
+  __m128 ve, vscale, voffset, vx0, vdx, vmin, vmax, vi, four, ry;
+  gint i;
+
+  ve      = _mm_set1_ps (e);
+  vscale  = _mm_set1_ps (scale);
+  voffset = _mm_set1_ps (offset);
+  vx0     = _mm_set1_ps (x0);
+  vdx     = _mm_set1_ps (dx);
+  vmin    = _mm_set1_ps (min_y);
+  vmax    = _mm_set1_ps (max_y);
+  four    = _mm_set1_ps (4.0f);
+
+  vi = _mm_cvtepi32_ps (_mm_add_epi32 (_mm_set1_epi32 (start),
+                                       _mm_setr_epi32 (0, 1, 2, 3)));
+  for (i = start; i + 4 <= end; i += 4)
+    {
+      ry = pow_sse2 (_mm_add_ps (vx0, _mm_mul_ps (vi, vdx)), ve);
+      ry = _mm_add_ps (voffset, _mm_mul_ps (vscale, ry));
+      _mm_storeu_ps (vector + (i - start), _mm_min_ps (_mm_max_ps (ry, vmin), vmax));
+      vi = _mm_add_ps (vi, four);
+    }
+
+  power_c (e, scale, offset, x0, dx, min_y, max_y, i, end, vector + (i - start));
+}
+
+__attribute__ ((target ("sse2")))
+static void
+logarithm_sse2 (gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+                gfloat min_y, gfloat max_y,
+                gint start, gint end, gfloat *vector)
+{
+  __m128 vscale, voffset, vx0, vdx, vmin, vmax, vi, four, ry;
+  gint i;
+
+  vscale  = _mm_set1_ps (scale);
+  voffset = _mm_set1_ps (offset);
+  vx0     = _mm_set1_ps (x0);
+  vdx     = _mm_set1_ps (dx);
+  vmin    = _mm_set1_ps (min_y);
+  vmax    = _mm_set1_ps (max_y);
+  four    = _mm_set1_ps (4.0f);
+
+  vi = _mm_cvtepi32_ps (_mm_add_epi32 (_mm_set1_epi32 (start),
+                                       _mm_setr_epi32 (0, 1, 2, 3)));
+  for (i = start; i + 4 <= end; i += 4)
+    {
+      ry = log2_sse2 (_mm_add_ps (vx0, _mm_mul_ps (vi, vdx)));
+      ry = _mm_add_ps (voffset, _mm_mul_ps (vscale, ry));
+      _mm_storeu_ps (vector + (i - start), _mm_min_ps (_mm_max_ps (ry, vmin), vmax));
+      vi = _mm_add_ps (vi, four);
+    }
+
+  logarithm_c (scale, offset, x0, dx, min_y, max_y, i, end, vector + (i - start));
+}
+
+__attribute__ ((target ("sse2")))
+static void
+logistic_sse2 (gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+               gfloat min_y, gfloat max_y,
+               gint start, gint end, gfloat *vector)
+{
+  __m128 vscale, voffset, vx0, vdx, vmin, vmax, vi, four, one, ry;
+  gint i;
+
+  vscale  = _mm_set1_ps (scale);
+  voffset = _mm_set1_ps (offset);
+  vx0     = _mm_set1_ps (x0);
+  vdx     = _mm_set1_ps (dx);
+  vmin    = _mm_set1_ps (min_y);
+  vmax    = _mm_set1_ps (max_y);
+  four    = _mm_set1_ps (4.0f);
+  one     = _mm_set1_ps (1.0f);
+
+  vi = _mm_cvtepi32_ps (_mm_add_epi32 (_mm_set1_epi32 (start),
+                                       _mm_setr_epi32 (0, 1, 2, 3)));
+  for (i = start; i + 4 <= end; i += 4)
+    {
+      ry = exp2_sse2 (_mm_add_ps (vx0, _mm_mul_ps (vi, vdx)));
+      ry = _mm_add_ps (voffset, _mm_div_ps (vscale, _mm_add_ps (one, ry)));
+      _mm_storeu_ps (vector + (i - start), _mm_min_ps (_mm_max_ps (ry, vmin), vmax));
+      vi = _mm_add_ps (vi, four);
+    }
+
+  logistic_c (scale, offset, x0, dx, min_y, max_y, i, end, vector + (i - start));
+}
+
+__attribute__ ((target ("sse2")))
+static void
+exponential_sse2 (gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+                  gfloat min_y, gfloat max_y,
+                  gint start, gint end, gfloat *vector)
+{
+  __m128 vscale, voffset, vx0, vdx, vmin, vmax, vi, four, ry;
+  gint i;
+
+  vscale  = _mm_set1_ps (scale);
+  voffset = _mm_set1_ps (offset);
+  vx0     = _mm_set1_ps (x0);
+  vdx     = _mm_set1_ps (dx);
+  vmin    = _mm_set1_ps (min_y);
+  vmax    = _mm_set1_ps (max_y);
+  four    = _mm_set1_ps (4.0f);
+
+  vi = _mm_cvtepi32_ps (_mm_add_epi32 (_mm_set1_epi32 (start),
+                                       _mm_setr_epi32 (0, 1, 2, 3)));
+  for (i = start; i + 4 <= end; i += 4)
+    {
+      ry = exp2_sse2 (_mm_add_ps (vx0, _mm_mul_ps (vi, vdx)));
+      ry = _mm_add_ps (voffset, _mm_mul_ps (vscale, ry));
+      _mm_storeu_ps (vector + (i - start), _mm_min_ps (_mm_max_ps (ry, vmin), vmax));
+      vi = _mm_add_ps (vi, four);
+    }
+
+  exponential_c (scale, offset, x0, dx, min_y, max_y, i, end, vector + (i - start));
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128d
+log2_sse2d (__m128d t)
+{
+  __m128i bits;
+  __m128d e, m, big, one, s, s2, p;
+
+  one  = _mm_set1_pd (1.0);
+  bits = _mm_castpd_si128 (_mm_max_pd (t, _mm_set1_pd (MIN_D)));
+  /* the biased exponent k as 2^52 + k, less 2^52 + 1023 */
+  e    = _mm_castsi128_pd (_mm_or_si128 (_mm_srli_epi64 (bits, 52),
+                                         _mm_castpd_si128 (_mm_set1_pd (4503599627370496.0))));
+  e    = _mm_sub_pd (e, _mm_set1_pd (4503599627370496.0 + 1023.0));
+  m    = _mm_castsi128_pd (_mm_or_si128 (_mm_and_si128 (bits, _mm_set1_epi64x (G_GINT64_CONSTANT (0x000fffffffffffff))),
+                                         _mm_set1_epi64x (G_GINT64_CONSTANT (0x3ff0000000000000))));
+  big  = _mm_cmpgt_pd (m, _mm_set1_pd (SQRT2_D));
+  m    = _mm_mul_pd (m, _mm_or_pd (_mm_and_pd (big, _mm_set1_pd (0.5)),
+                                   _mm_andnot_pd (big, one)));
+  e    = _mm_add_pd (e, _mm_and_pd (big, one));
+
+  s  = _mm_div_pd (_mm_sub_pd (m, one), _mm_add_pd (m, one));
+  s2 = _mm_mul_pd (s, s);
+  p  = _mm_add_pd (_mm_mul_pd (_mm_set1_pd (LOG2_D15), s2), _mm_set1_pd (LOG2_D13));
+  p  = _mm_add_pd (_mm_mul_pd (p, s2), _mm_set1_pd (LOG2_D11));
+  p  = _mm_add_pd (_mm_mul_pd (p, s2), _mm_set1_pd (LOG2_D9));
+  p  = _mm_add_pd (_mm_mul_pd (p, s2), _mm_set1_pd (LOG2_D7));
+  p  = _mm_add_pd (_mm_mul_pd (p, s2), _mm_set1_pd (LOG2_D5));
+  p  = _mm_add_pd (_mm_mul_pd (p, s2), _mm_set1_pd (LOG2_D3));
+  p  = _mm_add_pd (_mm_mul_pd (p, s2), _mm_set1_pd (LOG2_D1));
+  return _mm_add_pd (e, _mm_mul_pd (s, p));
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128d
+exp2_sse2d (__m128d t)
+{
+  __m128i ni;
+  __m128d n, f, p;
+
+  t = _mm_max_pd (t, _mm_set1_pd (-1022.0));
+  t = _mm_min_pd (t, _mm_set1_pd (1023.0));
+  n = _mm_cvtepi32_pd (_mm_cvttpd_epi32 (t));
+  n = _mm_sub_pd (n, _mm_and_pd (_mm_cmplt_pd (t, n), _mm_set1_pd (1.0)));
+  f = _mm_sub_pd (t, n);
+
+  p = _mm_add_pd (_mm_mul_pd (_mm_set1_pd (EXP2_D11), f), _mm_set1_pd (EXP2_D10));
+  p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (EXP2_D9));
+  p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (EXP2_D8));
+  p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (EXP2_D7));
+  p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (EXP2_D6));
+  p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (EXP2_D5));
+  p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (EXP2_D4));
+  p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (EXP2_D3));
+  p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (EXP2_D2));
+  p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (EXP2_D1));
+  p = _mm_add_pd (_mm_mul_pd (p, f), _mm_set1_pd (EXP2_D0));
+
+  /* two 32 bit n + 1023 widened to 64 bits */
+  ni = _mm_add_epi32 (_mm_cvttpd_epi32 (n), _mm_set1_epi32 (1023));
+  ni = _mm_unpacklo_epi32 (ni, _mm_setzero_si128 ());
+  return _mm_mul_pd (p, _mm_castsi128_pd (_mm_slli_epi64 (ni, 52)));
+}
+
+__attribute__ ((target ("sse2")))
+static inline __m128d
+pow_sse2d (__m128d t, __m128d e)
+{
+  return _mm_and_pd (_mm_cmpgt_pd (t, _mm_setzero_pd ()),
+                     exp2_sse2d (_mm_mul_pd (e, log2_sse2d (t))));
+}
+
+/* ratio for two samples, in double */
+__attribute__ ((target ("sse2")))
+static inline __m128
+ratio_sse2_2 (__m128d t, __m128d ve1, __m128d ve2,
+              __m128d r0, __m128d r1, __m128d r2, __m128d r3,
+              __m128d vscale, __m128d voffset)
+{
+  __m128d w, q;
+
+  w = pow_sse2d (t, ve1);
+  q = _mm_div_pd (_mm_max_pd (_mm_add_pd (r0, _mm_mul_pd (r1, w)), _mm_setzero_pd ()),
+                  _mm_add_pd (r2, _mm_mul_pd (r3, w)));
+  return _mm_cvtpd_ps (_mm_add_pd (voffset, _mm_mul_pd (vscale, pow_sse2d (q, ve2))));
+}
+
+__attribute__ ((target ("sse2")))
+static void
+ratio_sse2 (gdouble e1, gdouble e2, const gdouble r[4],
+            gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+            gfloat min_y, gfloat max_y,
+            gint start, gint end, gfloat *vector)
+{
+  __m128d ve1, ve2, r0, r1, r2, r3, vscale, voffset;
+  __m128 vx0, vdx, vmin, vmax, vi, four, t, ry;
+  gint i;
+
+  ve1     = _mm_set1_pd (e1);
+  ve2     = _mm_set1_pd (e2);
+  r0      = _mm_set1_pd (r[0]);
+  r1      = _mm_set1_pd (r[1]);
+  r2      = _mm_set1_pd (r[2]);
+  r3      = _mm_set1_pd (r[3]);
+  vscale  = _mm_set1_pd (scale);
+  voffset = _mm_set1_pd (offset);
+  vx0     = _mm_set1_ps (x0);
+  vdx     = _mm_set1_ps (dx);
+  vmin    = _mm_set1_ps (min_y);
+  vmax    = _mm_set1_ps (max_y);
+  four    = _mm_set1_ps (4.0f);
+
+  vi = _mm_cvtepi32_ps (_mm_add_epi32 (_mm_set1_epi32 (start),
+                                       _mm_setr_epi32 (0, 1, 2, 3)));
+  for (i = start; i + 4 <= end; i += 4)
+    {
+      t  = _mm_add_ps (vx0, _mm_mul_ps (vi, vdx));
+      ry = _mm_movelh_ps (ratio_sse2_2 (_mm_cvtps_pd (t), ve1, ve2,
+                                        r0, r1, r2, r3, vscale, voffset),
+                          ratio_sse2_2 (_mm_cvtps_pd (_mm_movehl_ps (t, t)), ve1, ve2,
+                                        r0, r1, r2, r3, vscale, voffset));
+      _mm_storeu_ps (vector + (i - start), _mm_min_ps (_mm_max_ps (ry, vmin), vmax));
+      vi = _mm_add_ps (vi, four);
+    }
+
+  ratio_c (e1, e2, r, scale, offset, x0, dx, min_y, max_y, i, end, vector + (i - start));
+}
+
+/* SSE2 has no gather, resampling stays scalar */
+static const Gtk3CurveKernels kernels_sse2 =
+{
+  "sse2",
+  cubic_sse2,
+  resample_c,
+  project_sse2,
+  quantize_u8_sse2,
+  quantize_u16_sse2,
+  power_sse2,
+  logarithm_sse2,
+  logistic_sse2,
+  exponential_sse2,
+  ratio_sse2
+};
+
+/*                          =====================                          */
+/* ===========================      AVX2      ============================ */
+/*                          =====================                          */
+
+__attribute__ ((target ("avx2")))
+static void
+cubic_avx2 (const gfloat c[4], gfloat xk, gfloat x0, gfloat dx,
+            gfloat min_y, gfloat max_y,
+            gint start, gint end, gfloat *vector)
+{
+  __m256 c0, c1, c2, c3, vxk, vx0, vdx, vmin, vmax, vi, eight, t, ry;
+  gint i;
+
+  c0    = _mm256_set1_ps (c[0]);
+  c1    = _mm256_set1_ps (c[1]);
+  c2    = _mm256_set1_ps (c[2]);
+  c3    = _mm256_set1_ps (c[3]);
+  vxk   = _mm256_set1_ps (xk);
+  vx0   = _mm256_set1_ps (x0);
+  vdx   = _mm256_set1_ps (dx);
+  vmin  = _mm256_set1_ps (min_y);
+  vmax  = _mm256_set1_ps (max_y);
+  eight = _mm256_set1_ps (8.0f);
+
+  vi = _mm256_cvtepi32_ps (_mm256_add_epi32 (_mm256_set1_epi32 (start),
+                                             _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7)));
+  for (i = start; i + 8 <= end; i += 8)
+    {
+      /* no FMA on purpose, see the comment at the top */
+      t  = _mm256_sub_ps (_mm256_add_ps (vx0, _mm256_mul_ps (vi, vdx)), vxk);
+      ry = _mm256_add_ps (_mm256_mul_ps (c3, t), c2);
+      ry = _mm256_add_ps (_mm256_mul_ps (ry, t), c1);
+      ry = _mm256_add_ps (_mm256_mul_ps (ry, t), c0);
+      ry = _mm256_min_ps (_mm256_max_ps (ry, vmin), vmax);
+      _mm256_storeu_ps (vector + (i - start), ry);
+      vi = _mm256_add_ps (vi, eight);
+    }
+
+  cubic_c (c, xk, x0, dx, min_y, max_y, i, end, vector + (i - start));
+}
+
+/* i * n_samples / veclen for four indices.  The products are exact in
+ * double, the quotient is estimated and then corrected by one so the
+ * result matches the integer division. */
+__attribute__ ((target ("avx2")))
+static inline __m128i
+resample_avx2_index (__m256d vi, __m256d vn, __m256d vlen, __m256d vinv)
+{
+  __m256d num, q, one;
+
+  one = _mm256_set1_pd (1.0);
+  num = _mm256_mul_pd (vi, vn);
+  q   = _mm256_floor_pd (_mm256_mul_pd (num, vinv));
+  q   = _mm256_add_pd (q, _mm256_and_pd (one,
+                                         _mm256_cmp_pd (_mm256_mul_pd (_mm256_add_pd (q, one), vlen),
+                                                        num, _CMP_LE_OQ)));
+  q   = _mm256_sub_pd (q, _mm256_and_pd (one,
+                                         _mm256_cmp_pd (_mm256_mul_pd (q, vlen),
+                                                        num, _CMP_GT_OQ)));
+  return _mm256_cvttpd_epi32 (q);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+resample_avx2 (const gfloat *samples, gint n_samples, gint veclen,
+               gint start, gint end, gfloat *vector)
+{
+  __m256d vi, vn, vlen, vinv, four, eight;
+  __m256i idx;
+  gint i;
+
+  vn    = _mm256_set1_pd (n_samples);
+  vlen  = _mm256_set1_pd (veclen);
+  vinv  = _mm256_set1_pd (1.0 / veclen);
+  four  = _mm256_set1_pd (4.0);
+  eight = _mm256_set1_pd (8.0);
+  vi    = _mm256_add_pd (_mm256_set1_pd (start),
+                         _mm256_setr_pd (0.0, 1.0, 2.0, 3.0));
+
+  for (i = start; i + 8 <= end; i += 8)
+    {
+      idx = _mm256_castsi128_si256 (resample_avx2_index (vi, vn, vlen, vinv));
+      idx = _mm256_inserti128_si256 (idx, resample_avx2_index (_mm256_add_pd (vi, four),
+                                                               vn, vlen, vinv), 1);
+      _mm256_storeu_ps (vector + (i - start), _mm256_i32gather_ps (samples, idx, 4));
+      vi = _mm256_add_pd (vi, eight);
+    }
+
+  resample_c (samples, n_samples, veclen, i, end, vector + (i - start));
+}
+
+__attribute__ ((target ("avx2")))
+static void
+project_avx2 (const gfloat *vector, gint n, gfloat min, gfloat scale,
+              gint x0, gint y0, gint *point)
+{
+  __m256 vmin, vscale, half;
+  __m256i vx, vy0, eight, y, lo, hi;
+  gint i;
+
+  vmin   = _mm256_set1_ps (min);
+  vscale = _mm256_set1_ps (scale);
+  half   = _mm256_set1_ps (0.5f);
+  vy0    = _mm256_set1_epi32 (y0);
+  eight  = _mm256_set1_epi32 (8);
+  vx     = _mm256_add_epi32 (_mm256_set1_epi32 (x0),
+                             _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7));
+
+  for (i = 0; i + 8 <= n; i += 8)
+    {
+      y = _mm256_cvttps_epi32 (_mm256_add_ps (_mm256_mul_ps (_mm256_sub_ps (_mm256_loadu_ps (vector + i),
+                                                                            vmin),
+                                                             vscale),
+                                              half));
+      y = _mm256_sub_epi32 (vy0, y);
+
+      /* interleave x and y, unpack works within 128 bit lanes */
+      lo = _mm256_unpacklo_epi32 (vx, y);
+      hi = _mm256_unpackhi_epi32 (vx, y);
+      _mm256_storeu_si256 ((__m256i *) (point + 2 * i),
+                           _mm256_permute2x128_si256 (lo, hi, 0x20));
+      _mm256_storeu_si256 ((__m256i *) (point + 2 * i + 8),
+                           _mm256_permute2x128_si256 (lo, hi, 0x31));
+      vx = _mm256_add_epi32 (vx, eight);
+    }
+
+  project_c (vector + i, n - i, min, scale, x0 + i, y0, point + 2 * i);
+}
+
+/* eight code values of QUANTIZE_C, as 32 bit integers */
+__attribute__ ((target ("avx2")))
+static inline __m256i
+quantize_avx2_8 (const gfloat *vector, __m256 vmin, __m256 vscale,
+                 __m256 vmax)
+{
+  __m256 r;
+
+  r = _mm256_add_ps (_mm256_mul_ps (_mm256_sub_ps (_mm256_loadu_ps (vector), vmin),
+                                    vscale),
+                     _mm256_set1_ps (0.5f));
+  r = _mm256_min_ps (_mm256_max_ps (r, _mm256_setzero_ps ()), vmax);
+  return _mm256_cvttps_epi32 (r);
+}
+
+/* packs work within 128 bit lanes, the permutes put the results back
+ * in order */
+__attribute__ ((target ("avx2")))
+static void
+quantize_u8_avx2 (const gfloat *vector, gint n, gfloat min, gfloat scale,
+                  gint max_code, guint8 *code)
+{
+  __m256 vmin, vscale, vmax;
+  __m256i ab, cd;
+  gint i;
+
+  vmin   = _mm256_set1_ps (min);
+  vscale = _mm256_set1_ps (scale);
+  vmax   = _mm256_set1_ps (max_code);
+
+  for (i = 0; i + 32 <= n; i += 32)
+    {
+      ab = _mm256_packus_epi32 (quantize_avx2_8 (vector + i,      vmin, vscale, vmax),
+                                quantize_avx2_8 (vector + i + 8,  vmin, vscale, vmax));
+      cd = _mm256_packus_epi32 (quantize_avx2_8 (vector + i + 16, vmin, vscale, vmax),
+                                quantize_avx2_8 (vector + i + 24, vmin, vscale, vmax));
+      _mm256_storeu_si256 ((__m256i *) (code + i),
+                           _mm256_permutevar8x32_epi32 (_mm256_packus_epi16 (ab, cd),
+                                                        _mm256_setr_epi32 (0, 4, 1, 5,
+                                                                           2, 6, 3, 7)));
+    }
+
+  quantize_u8_c (vector + i, n - i, min, scale, max_code, code + i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+quantize_u16_avx2 (const gfloat *vector, gint n, gfloat min, gfloat scale,
+                   gint max_code, guint16 *code)
+{
+  __m256 vmin, vscale, vmax;
+  __m256i ab;
+  gint i;
+
+  vmin   = _mm256_set1_ps (min);
+  vscale = _mm256_set1_ps (scale);
+  vmax   = _mm256_set1_ps (max_code);
+
+  for (i = 0; i + 16 <= n; i += 16)
+    {
+      ab = _mm256_packus_epi32 (quantize_avx2_8 (vector + i,     vmin, vscale, vmax),
+                                quantize_avx2_8 (vector + i + 8, vmin, vscale, vmax));
+      _mm256_storeu_si256 ((__m256i *) (code + i),
+                           _mm256_permute4x64_epi64 (ab, 0xd8));
+    }
+
+  quantize_u16_c (vector + i, n - i, min, scale, max_code, code + i);
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256
+log2_avx2 (__m256 t)
+{
+  __m256i bits;
+  __m256 e, m, big, one, s, s2, p;
+
+  one  = _mm256_set1_ps (1.0f);
+  bits = _mm256_castps_si256 (_mm256_max_ps (t, _mm256_set1_ps (MIN_F)));
+  e    = _mm256_cvtepi32_ps (_mm256_sub_epi32 (_mm256_srli_epi32 (bits, 23),
+                                               _mm256_set1_epi32 (127)));
+  m    = _mm256_castsi256_ps (_mm256_or_si256 (_mm256_and_si256 (bits, _mm256_set1_epi32 (0x007fffff)),
+                                               _mm256_set1_epi32 (0x3f800000)));
+  big  = _mm256_cmp_ps (m, _mm256_set1_ps (SQRT2_F), _CMP_GT_OQ);
+  m    = _mm256_mul_ps (m, _mm256_blendv_ps (one, _mm256_set1_ps (0.5f), big));
+  e    = _mm256_add_ps (e, _mm256_and_ps (big, one));
+
+  s  = _mm256_div_ps (_mm256_sub_ps (m, one), _mm256_add_ps (m, one));
+  s2 = _mm256_mul_ps (s, s);
+  p  = _mm256_add_ps (_mm256_mul_ps (_mm256_set1_ps (LOG2_C7), s2), _mm256_set1_ps (LOG2_C5));
+  p  = _mm256_add_ps (_mm256_mul_ps (p, s2), _mm256_set1_ps (LOG2_C3));
+  p  = _mm256_add_ps (_mm256_mul_ps (p, s2), _mm256_set1_ps (LOG2_C1));
+  return _mm256_add_ps (e, _mm256_mul_ps (s, p));
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256
+exp2_avx2 (__m256 t)
+{
+  __m256 n, f, p;
+
+  t = _mm256_max_ps (t, _mm256_set1_ps (-126.0f));
+  t = _mm256_min_ps (t, _mm256_set1_ps (127.0f));
+  n = _mm256_floor_ps (t);
+  f = _mm256_sub_ps (t, n);
+
+  p = _mm256_add_ps (_mm256_mul_ps (_mm256_set1_ps (EXP2_C6), f), _mm256_set1_ps (EXP2_C5));
+  p = _mm256_add_ps (_mm256_mul_ps (p, f), _mm256_set1_ps (EXP2_C4));
+  p = _mm256_add_ps (_mm256_mul_ps (p, f), _mm256_set1_ps (EXP2_C3));
+  p = _mm256_add_ps (_mm256_mul_ps (p, f), _mm256_set1_ps (EXP2_C2));
+  p = _mm256_add_ps (_mm256_mul_ps (p, f), _mm256_set1_ps (EXP2_C1));
+  p = _mm256_add_ps (_mm256_mul_ps (p, f), _mm256_set1_ps (EXP2_C0));
+  return _mm256_mul_ps (p, _mm256_castsi256_ps (_mm256_slli_epi32 (_mm256_add_epi32 (_mm256_cvttps_epi32 (n),
+                                                                                     _mm256_set1_epi32 (127)),
+                                                                   23)));
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256
+pow_avx2 (__m256 t, __m256 e)
+{
+  return _mm256_and_ps (_mm256_cmp_ps (t, _mm256_setzero_ps (), _CMP_GT_OQ),
+                        exp2_avx2 (_mm256_mul_ps (e, log2_avx2 (t))));
+}
+
+__attribute__ ((target ("avx2")))
+static void
+power_avx2 (gfloat e, gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+            gfloat min_y, gfloat max_y,
+            gint start, gint end, gfloat *vector)
+{
+  __m256 ve, vscale, voffset, vx0, vdx, vmin, vmax, vi, eight, ry;
+  gint i;
+
+  ve      = _mm256_set1_ps (e);
+  vscale  = _mm256_set1_ps (scale);
+  voffset = _mm256_set1_ps (offset);
+  vx0     = _mm256_set1_ps (x0);
+  vdx     = _mm256_set1_ps (dx);
+  vmin    = _mm256_set1_ps (min_y);
+  vmax    = _mm256_set1_ps (max_y);
+  eight   = _mm256_set1_ps (8.0f);
+
+  vi = _mm256_cvtepi32_ps (_mm256_add_epi32 (_mm256_set1_epi32 (start),
+                                             _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7)));
+  for (i = start; i + 8 <= end; i += 8)
+    {
+      ry = pow_avx2 (_mm256_add_ps (vx0, _mm256_mul_ps (vi, vdx)), ve);
+      ry = _mm256_add_ps (voffset, _mm256_mul_ps (vscale, ry));
+      _mm256_storeu_ps (vector + (i - start), _mm256_min_ps (_mm256_max_ps (ry, vmin), vmax));
+      vi = _mm256_add_ps (vi, eight);
+    }
+
+  power_c (e, scale, offset, x0, dx, min_y, max_y, i, end, vector + (i - start));
+}
+
+__attribute__ ((target ("avx2")))
+static void
+logarithm_avx2 (gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+                gfloat min_y, gfloat max_y,
+                gint start, gint end, gfloat *vector)
+{
+  __m256 vscale, voffset, vx0, vdx, vmin, vmax, vi, eight, ry;
+  gint i;
+
+  vscale  = _mm256_set1_ps (scale);
+  voffset = _mm256_set1_ps (offset);
+  vx0     = _mm256_set1_ps (x0);
+  vdx     = _mm256_set1_ps (dx);
+  vmin    = _mm256_set1_ps (min_y);
+  vmax    = _mm256_set1_ps (max_y);
+  eight   = _mm256_set1_ps (8.0f);
+
+  vi = _mm256_cvtepi32_ps (_mm256_add_epi32 (_mm256_set1_epi32 (start),
+                                             _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7)));
+  for (i = start; i + 8 <= end; i += 8)
+    {
+      ry = log2_avx2 (_mm256_add_ps (vx0, _mm256_mul_ps (vi, vdx)));
+      ry = _mm256_add_ps (voffset, _mm256_mul_ps (vscale, ry));
+      _mm256_storeu_ps (vector + (i - start), _mm256_min_ps (_mm256_max_ps (ry, vmin), vmax));
+      vi = _mm256_add_ps (vi, eight);
+    }
+
+  logarithm_c (scale, offset, x0, dx, min_y, max_y, i, end, vector + (i - start));
+}
+
+__attribute__ ((target ("avx2")))
+static void
+logistic_avx2 (gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+               gfloat min_y, gfloat max_y,
+               gint start, gint end, gfloat *vector)
+{
+  __m256 vscale, voffset, vx0, vdx, vmin, vmax, vi, eight, one, ry;
+  gint i;
+
+  vscale  = _mm256_set1_ps (scale);
+  voffset = _mm256_set1_ps (offset);
+  vx0     = _mm256_set1_ps (x0);
+  vdx     = _mm256_set1_ps (dx);
+  vmin    = _mm256_set1_ps (min_y);
+  vmax    = _mm256_set1_ps (max_y);
+  eight   = _mm256_set1_ps (8.0f);
+  one     = _mm256_set1_ps (1.0f);
+
+  vi = _mm256_cvtepi32_ps (_mm256_add_epi32 (_mm256_set1_epi32 (start),
+                                             _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7)));
+  for (i = start; i + 8 <= end; i += 8)
+    {
+      ry = exp2_avx2 (_mm256_add_ps (vx0, _mm256_mul_ps (vi, vdx)));
+      ry = _mm256_add_ps (voffset, _mm256_div_ps (vscale, _mm256_add_ps (one, ry)));
+      _mm256_storeu_ps (vector + (i - start), _mm256_min_ps (_mm256_max_ps (ry, vmin), vmax));
+      vi = _mm256_add_ps (vi, eight);
+    }
+
+  logistic_c (scale, offset, x0, dx, min_y, max_y, i, end, vector + (i - start));
+}
+
+__attribute__ ((target ("avx2")))
+static void
+exponential_avx2 (gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+                  gfloat min_y, gfloat max_y,
+                  gint start, gint end, gfloat *vector)
+{
+  __m256 vscale, voffset, vx0, vdx, vmin, vmax, vi, eight, ry;
+  gint i;
+
+  vscale  = _mm256_set1_ps (scale);
+  voffset = _mm256_set1_ps (offset);
+  vx0     = _mm256_set1_ps (x0);
+  vdx     = _mm256_set1_ps (dx);
+  vmin    = _mm256_set1_ps (min_y);
+  vmax    = _mm256_set1_ps (max_y);
+  eight   = _mm256_set1_ps (8.0f);
+
+  vi = _mm256_cvtepi32_ps (_mm256_add_epi32 (_mm256_set1_epi32 (start),
+                                             _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7)));
+  for (i = start; i + 8 <= end; i += 8)
+    {
+      ry = exp2_avx2 (_mm256_add_ps (vx0, _mm256_mul_ps (vi, vdx)));
+      ry = _mm256_add_ps (voffset, _mm256_mul_ps (vscale, ry));
+      _mm256_storeu_ps (vector + (i - start), _mm256_min_ps (_mm256_max_ps (ry, vmin), vmax));
+      vi = _mm256_add_ps (vi, eight);
+    }
+
+  exponential_c (scale, offset, x0, dx, min_y, max_y, i, end, vector + (i - start));
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256d
+log2_avx2d (__m256d t)
+{
+  __m256i bits;
+  __m256d e, m, big, one, s, s2, p;
+
+  one  = _mm256_set1_pd (1.0);
+  bits = _mm256_castpd_si256 (_mm256_max_pd (t, _mm256_set1_pd (MIN_D)));
+  e    = _mm256_castsi256_pd (_mm256_or_si256 (_mm256_srli_epi64 (bits, 52),
+                                               _mm256_castpd_si256 (_mm256_set1_pd (4503599627370496.0))));
+  e    = _mm256_sub_pd (e, _mm256_set1_pd (4503599627370496.0 + 1023.0));
+  m    = _mm256_castsi256_pd (_mm256_or_si256 (_mm256_and_si256 (bits, _mm256_set1_epi64x (G_GINT64_CONSTANT (0x000fffffffffffff))),
+                                               _mm256_set1_epi64x (G_GINT64_CONSTANT (0x3ff0000000000000))));
+  big  = _mm256_cmp_pd (m, _mm256_set1_pd (SQRT2_D), _CMP_GT_OQ);
+  m    = _mm256_mul_pd (m, _mm256_blendv_pd (one, _mm256_set1_pd (0.5), big));
+  e    = _mm256_add_pd (e, _mm256_and_pd (big, one));
+
+  s  = _mm256_div_pd (_mm256_sub_pd (m, one), _mm256_add_pd (m, one));
+  s2 = _mm256_mul_pd (s, s);
+  p  = _mm256_add_pd (_mm256_mul_pd (_mm256_set1_pd (LOG2_D15), s2), _mm256_set1_pd (LOG2_D13));
+  p  = _mm256_add_pd (_mm256_mul_pd (p, s2), _mm256_set1_pd (LOG2_D11));
+  p  = _mm256_add_pd (_mm256_mul_pd (p, s2), _mm256_set1_pd (LOG2_D9));
+  p  = _mm256_add_pd (_mm256_mul_pd (p, s2), _mm256_set1_pd (LOG2_D7));
+  p  = _mm256_add_pd (_mm256_mul_pd (p, s2), _mm256_set1_pd (LOG2_D5));
+  p  = _mm256_add_pd (_mm256_mul_pd (p, s2), _mm256_set1_pd (LOG2_D3));
+  p  = _mm256_add_pd (_mm256_mul_pd (p, s2), _mm256_set1_pd (LOG2_D1));
+  return _mm256_add_pd (e, _mm256_mul_pd (s, p));
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256d
+exp2_avx2d (__m256d t)
+{
+  __m128i ni;
+  __m256d n, f, p;
+
+  t = _mm256_max_pd (t, _mm256_set1_pd (-1022.0));
+  t = _mm256_min_pd (t, _mm256_set1_pd (1023.0));
+  n = _mm256_floor_pd (t);
+  f = _mm256_sub_pd (t, n);
+
+  p = _mm256_add_pd (_mm256_mul_pd (_mm256_set1_pd (EXP2_D11), f), _mm256_set1_pd (EXP2_D10));
+  p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (EXP2_D9));
+  p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (EXP2_D8));
+  p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (EXP2_D7));
+  p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (EXP2_D6));
+  p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (EXP2_D5));
+  p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (EXP2_D4));
+  p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (EXP2_D3));
+  p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (EXP2_D2));
+  p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (EXP2_D1));
+  p = _mm256_add_pd (_mm256_mul_pd (p, f), _mm256_set1_pd (EXP2_D0));
+
+  ni = _mm_add_epi32 (_mm256_cvttpd_epi32 (n), _mm_set1_epi32 (1023));
+  return _mm256_mul_pd (p, _mm256_castsi256_pd (_mm256_slli_epi64 (_mm256_cvtepi32_epi64 (ni), 52)));
+}
+
+__attribute__ ((target ("avx2")))
+static inline __m256d
+pow_avx2d (__m256d t, __m256d e)
+{
+  return _mm256_and_pd (_mm256_cmp_pd (t, _mm256_setzero_pd (), _CMP_GT_OQ),
+                        exp2_avx2d (_mm256_mul_pd (e, log2_avx2d (t))));
+}
+
+/* ratio for four samples, in double */
+__attribute__ ((target ("avx2")))
+static inline __m128
+ratio_avx2_4 (__m256d t, __m256d ve1, __m256d ve2,
+              __m256d r0, __m256d r1, __m256d r2, __m256d r3,
+              __m256d vscale, __m256d voffset)
+{
+  __m256d w, q;
+
+  w = pow_avx2d (t, ve1);
+  q = _mm256_div_pd (_mm256_max_pd (_mm256_add_pd (r0, _mm256_mul_pd (r1, w)),
+                                    _mm256_setzero_pd ()),
+                     _mm256_add_pd (r2, _mm256_mul_pd (r3, w)));
+  return _mm256_cvtpd_ps (_mm256_add_pd (voffset,
+                                         _mm256_mul_pd (vscale, pow_avx2d (q, ve2))));
+}
+
+__attribute__ ((target ("avx2")))
+static void
+ratio_avx2 (gdouble e1, gdouble e2, const gdouble r[4],
+            gfloat scale, gfloat offset, gfloat x0, gfloat dx,
+            gfloat min_y, gfloat max_y,
+            gint start, gint end, gfloat *vector)
+{
+  __m256d ve1, ve2, r0, r1, r2, r3, vscale, voffset;
+  __m256 vx0, vdx, vmin, vmax, vi, eight, t, ry;
+  gint i;
+
+  ve1     = _mm256_set1_pd (e1);
+  ve2     = _mm256_set1_pd (e2);
+  r0      = _mm256_set1_pd (r[0]);
+  r1      = _mm256_set1_pd (r[1]);
+  r2      = _mm256_set1_pd (r[2]);
+  r3      = _mm256_set1_pd (r[3]);
+  vscale  = _mm256_set1_pd (scale);
+  voffset = _mm256_set1_pd (offset);
+  vx0     = _mm256_set1_ps (x0);
+  vdx     = _mm256_set1_ps (dx);
+  vmin    = _mm256_set1_ps (min_y);
+  vmax    = _mm256_set1_ps (max_y);
+  eight   = _mm256_set1_ps (8.0f);
+
+  vi = _mm256_cvtepi32_ps (_mm256_add_epi32 (_mm256_set1_epi32 (start),
+                                             _mm256_setr_epi32 (0, 1, 2, 3, 4, 5, 6, 7)));
+  for (i = start; i + 8 <= end; i += 8)
+    {
+      t  = _mm256_add_ps (vx0, _mm256_mul_ps (vi, vdx));
+      ry = _mm256_set_m128 (ratio_avx2_4 (_mm256_cvtps_pd (_mm256_extractf128_ps (t, 1)),
+                                          ve1, ve2, r0, r1, r2, r3, vscale, voffset),
+                            ratio_avx2_4 (_mm256_cvtps_pd (_mm256_castps256_ps128 (t)),
+                                          ve1, ve2, r0, r1, r2, r3, vscale, voffset));
+      _mm256_storeu_ps (vector + (i - start), _mm256_min_ps (_mm256_max_ps (ry, vmin), vmax));
+      vi = _mm256_add_ps (vi, eight);
+    }
+
+  ratio_c (e1, e2, r, scale, offset, x0, dx, min_y, max_y, i, end, vector + (i - start));
+}
+
+static const Gtk3CurveKernels kernels_avx2 =
+{
+  "avx2",
+  cubic_avx2,
+  resample_avx2,
+  project_avx2,
+  quantize_u8_avx2,
+  quantize_u16_avx2,
+  power_avx2,
+  logarithm_avx2,
+  logistic_avx2,
+  exponential_avx2,
+  ratio_avx2
+};
+
+#endif /* HAVE_X86_KERNELS */
+
+/*                          =====================                           */
+/* =========================== PUBLIC FUNCTIONS =========================== */
+/*                          =====================                           */
+
+/* Returns the fastest kernels the CPU supports, chosen on first use. */
+const Gtk3CurveKernels *
+gtk3_curve_kernels_get (void)
+{
+  static const Gtk3CurveKernels *kernels = NULL;
+
+  if (g_once_init_enter (&kernels))
+    {
+      const Gtk3CurveKernels *best = &kernels_c;
+
+#ifdef HAVE_X86_KERNELS
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("avx2"))
+        best = &kernels_avx2;
+      else if (__builtin_cpu_supports ("sse2"))
+        best = &kernels_sse2;
+#endif
+
+      DEBUG_INFO("curve kernels: %s\n", best->name);
+
+      g_once_init_leave (&kernels, best);
+    }
+
+  return kernels;
+}
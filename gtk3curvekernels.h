@@ -0,0 +1,151 @@
+/* Copyright (C) 2016 Benoit Touchette
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation version
+ * 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Private header, not installed. */
+
+#ifndef __GTK3_CURVE_KERNELS__H__
+#define __GTK3_CURVE_KERNELS__H__
+
+#include <glib.h>
+
+typedef struct _Gtk3CurveKernels    Gtk3CurveKernels;
+
+/* Inner loops of the curve evaluation.  Every implementation computes the
+ * sample position as x0 + i * dx from its index, so all of them produce
+ * the same values and may be mixed within one vector. */
+struct _Gtk3CurveKernels
+{
+  const gchar *name;
+
+  /* vector[i - start] = CLAMP (((c[3] t + c[2]) t + c[1]) t + c[0],
+   * min_y, max_y) for start <= i < end, with t = (x0 + i * dx) - xk */
+  void (* cubic)    (const gfloat  c[4],
+                     gfloat        xk,
+                     gfloat        x0,
+                     gfloat        dx,
+                     gfloat        min_y,
+                     gfloat        max_y,
+                     gint          start,
+                     gint          end,
+                     gfloat       *vector);
+
+  /* vector[i - start] = samples[i * n_samples / veclen] for
+   * start <= i < end */
+  void (* resample) (const gfloat *samples,
+                     gint          n_samples,
+                     gint          veclen,
+                     gint          start,
+                     gint          end,
+                     gfloat       *vector);
+
+  /* point[2 i] = x0 + i and
+   * point[2 i + 1] = y0 - (gint) ((vector[i] - min) * scale + 0.5)
+   * for 0 <= i < n, i.e. pixel coordinates of the curve */
+  void (* project)  (const gfloat *vector,
+                     gint          n,
+                     gfloat        min,
+                     gfloat        scale,
+                     gint          x0,
+                     gint          y0,
+                     gint         *point);
+
+  /* code[i] = (gint) CLAMP ((vector[i] - min) * scale + 0.5, 0, max_code)
+   * for 0 <= i < n, i.e. code values rounded to nearest, halves up */
+  void (* quantize_u8)  (const gfloat *vector,
+                         gint          n,
+                         gfloat        min,
+                         gfloat        scale,
+                         gint          max_code,
+                         guint8       *code);
+  void (* quantize_u16) (const gfloat *vector,
+                         gint          n,
+                         gfloat        min,
+                         gfloat        scale,
+                         gint          max_code,
+                         guint16      *code);
+
+  /* The analytic kernels use fast log2 and exp2 approximations: log2 (t)
+   * is within 2^-22 MAX (1, |log2 (t)|) for t >= FLT_MIN, smaller t are
+   * taken as FLT_MIN; 2^t is within a relative 2^-22 for -126 <= t <=
+   * 127, t is clamped to that.  With t = x0 + i * dx, start <= i < end: */
+
+  /* vector[i - start] = CLAMP (offset + scale * t^e, min_y, max_y),
+   * t^e = 0 for t <= 0; t^e is within a relative 2^-21 (1 + |e log2 (t)|) */
+  void (* power)     (gfloat        e,
+                      gfloat        scale,
+                      gfloat        offset,
+                      gfloat        x0,
+                      gfloat        dx,
+                      gfloat        min_y,
+                      gfloat        max_y,
+                      gint          start,
+                      gint          end,
+                      gfloat       *vector);
+
+  /* vector[i - start] = CLAMP (offset + scale * log2 (t), min_y, max_y) */
+  void (* logarithm) (gfloat        scale,
+                      gfloat        offset,
+                      gfloat        x0,
+                      gfloat        dx,
+                      gfloat        min_y,
+                      gfloat        max_y,
+                      gint          start,
+                      gint          end,
+                      gfloat       *vector);
+
+  /* vector[i - start] = CLAMP (offset + scale / (1 + 2^t), min_y, max_y) */
+  void (* logistic)  (gfloat        scale,
+                      gfloat        offset,
+                      gfloat        x0,
+                      gfloat        dx,
+                      gfloat        min_y,
+                      gfloat        max_y,
+                      gint          start,
+                      gint          end,
+                      gfloat       *vector);
+
+  /* vector[i - start] = CLAMP (offset + scale * 2^t, min_y, max_y) */
+  void (* exponential) (gfloat      scale,
+                        gfloat      offset,
+                        gfloat      x0,
+                        gfloat      dx,
+                        gfloat      min_y,
+                        gfloat      max_y,
+                        gint        start,
+                        gint        end,
+                        gfloat     *vector);
+
+  /* vector[i - start] = CLAMP (offset + scale q^e2, min_y, max_y) with
+   * q = MAX (r[0] + r[1] w, 0) / (r[2] + r[3] w) and w = t^e1, the form
+   * of the PQ transfer function; computed in double from the float t,
+   * to within a few double ulp, as its exponents magnify rounding */
+  void (* ratio)     (gdouble       e1,
+                      gdouble       e2,
+                      const gdouble r[4],
+                      gfloat        scale,
+                      gfloat        offset,
+                      gfloat        x0,
+                      gfloat        dx,
+                      gfloat        min_y,
+                      gfloat        max_y,
+                      gint          start,
+                      gint          end,
+                      gfloat       *vector);
+};
+
+const Gtk3CurveKernels *gtk3_curve_kernels_get (void);
+
+#endif /* __GTK3_CURVE_KERNELS__H__ */
@@ -0,0 +1,2343 @@
+/* Copyright (C) 2016 Benoit Touchette
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation version
+ * 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Portions of this code Copyright (C) 1997 David Mosberger and
+ * Copyright (C) 1997 - 2000 GTK+ Team.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+
+#include <glib-object.h>
+
+#include "gtk3curvemodel.h"
+#include "gtk3curveinterp.h"
+#include "gtk3curvekernels.h"
+
+#ifdef DEBUG
+#define DEBUG_INFO g_print
+#define DEBUG_ERROR g_printerr
+#else
+#define DEBUG_INFO(...)
+#define DEBUG_ERROR(...)
+#endif
+
+#define _gtk3_marshal_VOID__VOID  g_cclosure_marshal_VOID__VOID
+
+#define GTK3_PARAM_READWRITE G_PARAM_READWRITE|G_PARAM_STATIC_NAME|G_PARAM_STATIC_NICK|G_PARAM_STATIC_BLURB
+
+#define N_FREE_CPOINTS   9 /* control points created when leaving free form */
+#define CPOINTS_ALIGN   32 /* alignment of the control point arrays, in bytes */
+
+/* get_vector spreads vectors of at least PARALLEL_MIN_SAMPLES over the
+ * thread pool, in chunks of no less than PARALLEL_MIN_CHUNK samples */
+#define PARALLEL_MIN_SAMPLES  (1 << 16)
+#define PARALLEL_MIN_CHUNK    (1 << 14)
+
+/* samples not stored as contiguous floats are evaluated this many at a
+ * time into a buffer and converted from there */
+#define EVAL_BLOCK  256
+
+struct _Gtk3CurveModelPrivate
+{
+  /* guards everything below, signals are emitted without it held */
+  GMutex lock;
+
+  Gtk3CurveType curve_type;
+
+  gfloat min_x;
+  gfloat max_x;
+  gfloat min_y;
+  gfloat max_y;
+
+  /* control points, x in cpx and y in cpy, and the slopes of their
+   * Bezier handles into and out of the point in cpl and cpr, NAN when
+   * automatic; all hold n_cpoints_alloc floats and are CPOINTS_ALIGN
+   * aligned in the d_cpoints block */
+  gint n_cpoints;
+  gint n_cpoints_alloc;
+  gpointer d_cpoints;
+  gfloat *cpx;
+  gfloat *cpy;
+  gfloat *cpl;
+  gfloat *cpr;
+
+  /* of Catmull-Rom and automatic Bezier tangents, 0 to 1 */
+  gfloat tension;
+
+  /* parameters of each analytic curve type, kept when switching types */
+  gfloat params[GTK3_CURVE_N_TYPES][GTK3_CURVE_N_PARAMS];
+
+  /* free form curve, evenly spaced over [min_x, max_x] */
+  gint n_samples;
+  gfloat *d_samples;
+
+  /* nesting of gtk3_curve_model_begin_update, and whether "changed" is
+   * owed once the outermost update ends */
+  gint freeze_count;
+  gboolean changed_pending;
+
+  /* range properties set but not applied yet, by PROP_MIN_X + i for bit
+   * i of range_set_mask; see gtk3_curve_model_dispatch_properties_changed */
+  gfloat range_set[4];
+  guint range_set_mask;
+
+  /* bumped on every change, see gtk3_curve_model_get_revision */
+  guint generation;
+  /* generation of the last range or type change */
+  guint layout_generation;
+
+  /* samples [free_start, free_end) were drawn by the free form segment
+   * that made free_generation */
+  guint free_generation;
+  gint free_start;
+  gint free_end;
+
+  /* the control point moved by the change that made edit_generation */
+  guint edit_generation;
+  gint edit_point;
+
+  /* active control points and their handles, valid while
+   * solved_generation matches generation; collected in place at
+   * local_generation, when only edit_point changed */
+  guint solved_generation;
+  guint solved_layout;
+  guint local_generation;
+  gint n_active;
+  gint n_solved_alloc;
+  gfloat *d_solved;
+  gfloat *xv;
+  gfloat *yv;
+  gfloat *lv;
+  gfloat *rv;
+
+  /* what each interpolator precomputed, for the active points of
+   * state_generation */
+  gpointer states[GTK3_CURVE_N_TYPES];
+  guint state_generation[GTK3_CURVE_N_TYPES];
+
+  /* x, and the knot values and derivatives (see Gtk3CurveKnots) of the
+   * active points as solved before, at prev_generation, to tell what
+   * changed since; prev_valid if the curve type has knots */
+  gboolean prev_valid;
+  guint prev_generation;
+  guint prev_layout;
+  gint n_prev;
+  gint n_prev_alloc;
+  gfloat *d_prev;
+};
+
+/* where gtk3_curve_model_eval_output puts the samples: in vector, or
+ * if that is NULL at data[offset + i * stride] as format, or if lut_bits
+ * is not 0 as code values of that many bits in lut8 or lut16 */
+typedef struct
+{
+  gfloat *vector;
+  Gtk3CurveFormat format;
+  gpointer data;
+  gint offset;
+  gint stride;
+  gint lut_bits;
+  guint8 *lut8;
+  guint16 *lut16;
+} EvalOutput;
+
+/* a parallel gtk3_curve_model_eval_output, see there */
+typedef struct
+{
+  Gtk3CurveModelPrivate *priv;
+  Gtk3CurveType type;
+  gint veclen;
+  const EvalOutput *output;
+
+  GMutex lock;
+  GCond cond;
+  gint pending;
+} EvalJob;
+
+typedef struct
+{
+  EvalJob *job;
+  gint start;
+  gint end;
+} EvalChunk;
+
+enum
+{
+  CHANGED,
+  LAST_SIGNAL
+};
+
+enum
+{
+  PROP_0,
+  PROP_CURVE_TYPE,
+  PROP_MIN_X,
+  PROP_MAX_X,
+  PROP_MIN_Y,
+  PROP_MAX_Y,
+  PROP_TENSION
+};
+
+static guint model_signals[LAST_SIGNAL] = { 0 };
+
+static void gtk3_curve_model_finalize       (GObject              *object);
+static void gtk3_curve_model_get_property   (GObject              *object,
+                                             guint                 param_id,
+                                             GValue               *value,
+                                             GParamSpec           *pspec);
+static void gtk3_curve_model_set_property   (GObject              *object,
+                                             guint                 param_id,
+                                             const GValue         *value,
+                                             GParamSpec           *pspec);
+static void gtk3_curve_model_dispatch_properties_changed (GObject     *object,
+                                                          guint        n_pspecs,
+                                                          GParamSpec **pspecs);
+static void gtk3_curve_model_apply_range_set (Gtk3CurveModel      *model);
+static void gtk3_curve_model_update_range   (Gtk3CurveModel        *model,
+                                             gfloat                 min_x,
+                                             gfloat                 max_x,
+                                             gfloat                 min_y,
+                                             gfloat                 max_y,
+                                             guint                  notified);
+static void gtk3_curve_model_emit_changed   (Gtk3CurveModel        *model);
+static void gtk3_curve_model_eval_vector    (Gtk3CurveModelPrivate *priv,
+                                             Gtk3CurveType         type,
+                                             gint                  veclen,
+                                             gint                  start,
+                                             gint                  end,
+                                             gfloat                vector[]);
+static void gtk3_curve_model_eval_output    (Gtk3CurveModelPrivate *priv,
+                                             Gtk3CurveType         type,
+                                             gint                  veclen,
+                                             gint                  start,
+                                             gint                  end,
+                                             const EvalOutput     *output);
+static void gtk3_curve_model_eval_range     (Gtk3CurveModelPrivate *priv,
+                                             Gtk3CurveType         type,
+                                             gint                  veclen,
+                                             gint                  start,
+                                             gint                  end,
+                                             const EvalOutput     *output);
+static void gtk3_curve_model_sample         (Gtk3CurveModelPrivate *priv,
+                                             Gtk3CurveType         type);
+static void gtk3_curve_model_solve          (Gtk3CurveModelPrivate *priv);
+static gboolean gtk3_curve_model_collect_local (Gtk3CurveModelPrivate *priv);
+static void gtk3_curve_model_prepare        (Gtk3CurveModelPrivate *priv,
+                                             Gtk3CurveType          type);
+static void gtk3_curve_model_points         (Gtk3CurveModelPrivate *priv,
+                                             Gtk3CurvePoints       *points);
+static void gtk3_curve_model_reserve        (Gtk3CurveModelPrivate *priv,
+                                             gint                   n);
+static void gtk3_curve_model_default_points (Gtk3CurveModelPrivate *priv);
+static void gtk3_curve_model_default_params (Gtk3CurveModelPrivate *priv);
+static gboolean gtk3_curve_model_dirty_span (Gtk3CurveModelPrivate *priv,
+                                             guint                  since,
+                                             gfloat                 tolerance,
+                                             gfloat                *lo,
+                                             gfloat                *hi,
+                                             gfloat                *error);
+static gboolean gtk3_curve_model_dirty      (Gtk3CurveModelPrivate *priv,
+                                             guint                 since,
+                                             gint                  veclen,
+                                             gfloat                tolerance,
+                                             gint                 *start,
+                                             gint                 *end,
+                                             gfloat               *error);
+G_DEFINE_TYPE_WITH_PRIVATE (Gtk3CurveModel, gtk3_curve_model, G_TYPE_OBJECT)
+
+
+GType
+gtk3_curve_type_get_type (void)
+{
+  static GType etype = 0;
+  if (G_UNLIKELY(etype == 0))
+    {
+      static const GEnumValue values[] =
+      {
+        { GTK3_CURVE_TYPE_LINEAR, "GTK3_CURVE_TYPE_LINEAR", "linear" },
+        { GTK3_CURVE_TYPE_SPLINE, "GTK3_CURVE_TYPE_SPLINE", "spline" },
+        { GTK3_CURVE_TYPE_FREE, "GTK3_CURVE_TYPE_FREE", "free" },
+        { GTK3_CURVE_TYPE_MONOTONE, "GTK3_CURVE_TYPE_MONOTONE", "monotone" },
+        { GTK3_CURVE_TYPE_CATMULL_ROM, "GTK3_CURVE_TYPE_CATMULL_ROM", "catmull-rom" },
+        { GTK3_CURVE_TYPE_BEZIER, "GTK3_CURVE_TYPE_BEZIER", "bezier" },
+        { GTK3_CURVE_TYPE_BSPLINE, "GTK3_CURVE_TYPE_BSPLINE", "bspline" },
+        { GTK3_CURVE_TYPE_GAMMA, "GTK3_CURVE_TYPE_GAMMA", "gamma" },
+        { GTK3_CURVE_TYPE_SIGMOID, "GTK3_CURVE_TYPE_SIGMOID", "sigmoid" },
+        { GTK3_CURVE_TYPE_LOG, "GTK3_CURVE_TYPE_LOG", "log" },
+        { GTK3_CURVE_TYPE_POWER, "GTK3_CURVE_TYPE_POWER", "power" },
+        { GTK3_CURVE_TYPE_TRANSFER, "GTK3_CURVE_TYPE_TRANSFER", "transfer" },
+        { 0, NULL, NULL }
+      };
+      etype = g_enum_register_static (g_intern_static_string ("Gtk3CurveType"),
+                                      values);
+    }
+  return etype;
+}
+
+static void
+gtk3_curve_model_class_init (Gtk3CurveModelClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = gtk3_curve_model_finalize;
+  gobject_class->set_property = gtk3_curve_model_set_property;
+  gobject_class->get_property = gtk3_curve_model_get_property;
+  gobject_class->dispatch_properties_changed =
+    gtk3_curve_model_dispatch_properties_changed;
+
+  g_object_class_install_property (gobject_class,
+                                   PROP_CURVE_TYPE,
+                                   g_param_spec_enum ("curve-type",
+                                       "Curve type",
+                                       "Is this curve linear, spline interpolated, or free-form",
+                                       GTK3_TYPE_CURVE_TYPE,
+                                       GTK3_CURVE_TYPE_SPLINE,
+                                       GTK3_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class,
+                                   PROP_MIN_X,
+                                   g_param_spec_float ("min-x",
+                                       "Minimum X",
+                                       "Minimum possible value for X",
+                                       -G_MAXFLOAT,
+                                       G_MAXFLOAT,
+                                       0.0,
+                                       GTK3_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_X,
+                                   g_param_spec_float ("max-x",
+                                       "Maximum X",
+                                       "Maximum possible X value",
+                                       -G_MAXFLOAT,
+                                       G_MAXFLOAT,
+                                       1.0,
+                                       GTK3_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class,
+                                   PROP_MIN_Y,
+                                   g_param_spec_float ("min-y",
+                                       "Minimum Y",
+                                       "Minimum possible value for Y",
+                                       -G_MAXFLOAT,
+                                       G_MAXFLOAT,
+                                       0.0,
+                                       GTK3_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_Y,
+                                   g_param_spec_float ("max-y",
+                                       "Maximum Y",
+                                       "Maximum possible value for Y",
+                                       -G_MAXFLOAT,
+                                       G_MAXFLOAT,
+                                       1.0,
+                                       GTK3_PARAM_READWRITE));
+  g_object_class_install_property (gobject_class,
+                                   PROP_TENSION,
+                                   g_param_spec_float ("tension",
+                                       "Tension",
+                                       "Tension of Catmull-Rom and automatic Bezier tangents",
+                                       0.0,
+                                       1.0,
+                                       0.0,
+                                       GTK3_PARAM_READWRITE));
+
+  model_signals[CHANGED] =
+    g_signal_new ("changed",
+                  G_OBJECT_CLASS_TYPE (gobject_class),
+                  G_SIGNAL_RUN_FIRST,
+                  G_STRUCT_OFFSET (Gtk3CurveModelClass, changed),
+                  NULL, NULL,
+                  _gtk3_marshal_VOID__VOID,
+                  G_TYPE_NONE, 0);
+}
+
+static void
+gtk3_curve_model_init (Gtk3CurveModel *self)
+{
+  Gtk3CurveModelPrivate *priv;
+
+  self->priv = gtk3_curve_model_get_instance_private (self);
+  priv = self->priv;
+
+  g_mutex_init (&priv->lock);
+
+  priv->curve_type = GTK3_CURVE_TYPE_SPLINE;
+
+  priv->min_x = 0.0;
+  priv->max_x = 1.0;
+  priv->min_y = 0.0;
+  priv->max_y = 1.0;
+  priv->tension = 0.0;
+
+  priv->n_cpoints = 0;
+  priv->n_cpoints_alloc = 0;
+  priv->d_cpoints = NULL;
+  gtk3_curve_model_default_points (priv);
+  gtk3_curve_model_default_params (priv);
+
+  priv->n_samples = 0;
+  priv->d_samples = NULL;
+
+  priv->freeze_count = 0;
+  priv->changed_pending = FALSE;
+  priv->range_set_mask = 0;
+
+  priv->generation = 1;
+  priv->solved_generation = 0;
+  priv->n_active = 0;
+  priv->n_solved_alloc = 0;
+  priv->d_solved = NULL;
+}
+
+Gtk3CurveModel *
+gtk3_curve_model_new (void)
+{
+  return g_object_new (GTK3_TYPE_CURVE_MODEL, NULL);
+}
+
+static void
+gtk3_curve_model_finalize (GObject *object)
+{
+  Gtk3CurveModelPrivate *priv = GTK3_CURVE_MODEL (object)->priv;
+  gint i;
+
+  for (i = 0; i < GTK3_CURVE_N_TYPES; ++i)
+    if (priv->states[i])
+      gtk3_curve_interpolator_get (i)->state_free (priv->states[i]);
+
+  g_free (priv->d_cpoints);
+  g_free (priv->d_samples);
+  g_free (priv->d_solved);
+  g_free (priv->d_prev);
+  g_mutex_clear (&priv->lock);
+
+  G_OBJECT_CLASS (gtk3_curve_model_parent_class)->finalize (object);
+}
+
+static void
+gtk3_curve_model_set_property (GObject              *object,
+                               guint                 prop_id,
+                               const GValue         *value,
+                               GParamSpec           *pspec)
+{
+  Gtk3CurveModel *model = GTK3_CURVE_MODEL (object);
+  Gtk3CurveModelPrivate *priv = model->priv;
+  gboolean frozen;
+
+  switch (prop_id)
+    {
+    case PROP_CURVE_TYPE:
+      gtk3_curve_model_set_curve_type (model, g_value_get_enum (value));
+      break;
+
+    case PROP_MIN_X:
+    case PROP_MAX_X:
+    case PROP_MIN_Y:
+    case PROP_MAX_Y:
+      /* kept until all properties of the g_object_set are set, so
+       * setting the whole range changes the model once; in an update
+       * "changed" is only emitted at its end anyway */
+      g_mutex_lock (&priv->lock);
+      priv->range_set[prop_id - PROP_MIN_X] = g_value_get_float (value);
+      priv->range_set_mask |= 1 << (prop_id - PROP_MIN_X);
+      frozen = priv->freeze_count > 0;
+      g_mutex_unlock (&priv->lock);
+      if (frozen)
+        gtk3_curve_model_apply_range_set (model);
+      break;
+
+    case PROP_TENSION:
+      gtk3_curve_model_set_tension (model, g_value_get_float (value));
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+}
+
+static void
+gtk3_curve_model_get_property (GObject              *object,
+                               guint                 prop_id,
+                               GValue               *value,
+                               GParamSpec           *pspec)
+{
+  Gtk3CurveModel *model = GTK3_CURVE_MODEL (object);
+  Gtk3CurveModelPrivate *priv = model->priv;
+  gfloat range[4];
+  gint i;
+
+  g_mutex_lock (&priv->lock);
+
+  switch (prop_id)
+    {
+    case PROP_CURVE_TYPE:
+      g_value_set_enum (value, priv->curve_type);
+      break;
+
+    case PROP_MIN_X:
+    case PROP_MAX_X:
+    case PROP_MIN_Y:
+    case PROP_MAX_Y:
+      /* as set, even if not applied yet */
+      range[0] = priv->min_x;
+      range[1] = priv->max_x;
+      range[2] = priv->min_y;
+      range[3] = priv->max_y;
+      i = prop_id - PROP_MIN_X;
+      if (priv->range_set_mask & (1 << i))
+        range[i] = priv->range_set[i];
+      g_value_set_float (value, range[i]);
+      break;
+
+    case PROP_TENSION:
+      g_value_set_float (value, priv->tension);
+      break;
+
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+    }
+
+  g_mutex_unlock (&priv->lock);
+}
+
+/* Applies the range properties set since the notifications were last
+ * dispatched, which g_object_set holds back until it has set them all. */
+static void
+gtk3_curve_model_dispatch_properties_changed (GObject     *object,
+                                              guint        n_pspecs,
+                                              GParamSpec **pspecs)
+{
+  gtk3_curve_model_apply_range_set (GTK3_CURVE_MODEL (object));
+
+  G_OBJECT_CLASS (gtk3_curve_model_parent_class)->dispatch_properties_changed
+    (object, n_pspecs, pspecs);
+}
+
+static void
+gtk3_curve_model_apply_range_set (Gtk3CurveModel *model)
+{
+  Gtk3CurveModelPrivate *priv = model->priv;
+  gfloat range[4];
+  guint mask;
+  gint i;
+
+  g_mutex_lock (&priv->lock);
+  mask = priv->range_set_mask;
+  priv->range_set_mask = 0;
+  range[0] = priv->min_x;
+  range[1] = priv->max_x;
+  range[2] = priv->min_y;
+  range[3] = priv->max_y;
+  for (i = 0; i < 4; ++i)
+    if (mask & (1 << i))
+      range[i] = priv->range_set[i];
+  g_mutex_unlock (&priv->lock);
+
+  /* their notifications are queued already */
+  if (mask != 0)
+    gtk3_curve_model_update_range (model, range[0], range[1],
+                                   range[2], range[3], mask);
+}
+
+/*                          =====================                          */
+/* ===========================   EVALUATION   ============================ */
+/*                          =====================                          */
+
+/* Emits "changed", or only records that it is owed while an update is
+ * in progress. */
+static void
+gtk3_curve_model_emit_changed (Gtk3CurveModel *model)
+{
+  Gtk3CurveModelPrivate *priv = model->priv;
+  gboolean frozen;
+
+  g_mutex_lock (&priv->lock);
+  frozen = priv->freeze_count > 0;
+  if (frozen)
+    priv->changed_pending = TRUE;
+  g_mutex_unlock (&priv->lock);
+
+  if (!frozen)
+    g_signal_emit (model, model_signals[CHANGED], 0);
+}
+
+/* Makes room for n control points.  The capacity at least doubles when
+ * it grows, so inserting points one by one costs amortised constant
+ * time.  Called with the lock held. */
+static void
+gtk3_curve_model_reserve (Gtk3CurveModelPrivate *priv, gint n)
+{
+  gpointer block;
+  gfloat *cpx;
+  gint alloc;
+
+  if (n <= priv->n_cpoints_alloc)
+    return;
+
+  /* a multiple of the alignment keeps the other arrays aligned too */
+  alloc = MAX (n, priv->n_cpoints_alloc * 2);
+  alloc = (alloc + CPOINTS_ALIGN / sizeof (gfloat) - 1) &
+          ~(gint) (CPOINTS_ALIGN / sizeof (gfloat) - 1);
+
+  block = g_malloc (4 * alloc * sizeof (gfloat) + CPOINTS_ALIGN - 1);
+  cpx = (gfloat *) (((guintptr) block + CPOINTS_ALIGN - 1) &
+                    ~(guintptr) (CPOINTS_ALIGN - 1));
+
+  if (priv->n_cpoints > 0)
+    {
+      memcpy (cpx, priv->cpx, priv->n_cpoints * sizeof (gfloat));
+      memcpy (cpx + alloc, priv->cpy, priv->n_cpoints * sizeof (gfloat));
+      memcpy (cpx + 2 * alloc, priv->cpl, priv->n_cpoints * sizeof (gfloat));
+      memcpy (cpx + 3 * alloc, priv->cpr, priv->n_cpoints * sizeof (gfloat));
+    }
+  g_free (priv->d_cpoints);
+
+  priv->d_cpoints = block;
+  priv->n_cpoints_alloc = alloc;
+  priv->cpx = cpx;
+  priv->cpy = cpx + alloc;
+  priv->cpl = cpx + 2 * alloc;
+  priv->cpr = cpx + 3 * alloc;
+}
+
+/* Sets the two control points of a new curve, at the corners of the
+ * range.  Called with the lock held. */
+static void
+gtk3_curve_model_default_points (Gtk3CurveModelPrivate *priv)
+{
+  gtk3_curve_model_reserve (priv, 2);
+  priv->n_cpoints = 2;
+  priv->cpx[0] = priv->min_x;
+  priv->cpy[0] = priv->min_y;
+  priv->cpx[1] = priv->max_x;
+  priv->cpy[1] = priv->max_y;
+  priv->cpl[0] = priv->cpr[0] = NAN;
+  priv->cpl[1] = priv->cpr[1] = NAN;
+}
+
+/* Sets the parameters of every analytic curve type to its defaults.
+ * Called with the lock held. */
+static void
+gtk3_curve_model_default_params (Gtk3CurveModelPrivate *priv)
+{
+  gint type;
+
+  for (type = 0; type < GTK3_CURVE_N_TYPES; ++type)
+    memcpy (priv->params[type], gtk3_curve_interpolator_get (type)->params,
+            sizeof (priv->params[type]));
+}
+
+/* Samples the control points with the given interpolation into the free
+ * form buffer, allocating it first if needed.  Called with the lock held. */
+static void
+gtk3_curve_model_sample (Gtk3CurveModelPrivate *priv, Gtk3CurveType type)
+{
+  if (priv->d_samples == NULL)
+    {
+      priv->n_samples = GTK3_CURVE_MODEL_FREE_SAMPLES;
+      priv->d_samples = g_malloc (priv->n_samples * sizeof (priv->d_samples[0]));
+    }
+
+  gtk3_curve_model_eval_vector (priv, type, priv->n_samples,
+                                0, priv->n_samples, priv->d_samples);
+}
+
+/* Collects the active control points, those with increasing x, and
+ * prepares the interpolator of the curve type for them.  Nothing is done
+ * while the points, range and type are unchanged since the last call, so
+ * repeated evaluations only pay for the evaluation itself.  Called with
+ * the lock held. */
+static void
+gtk3_curve_model_solve (Gtk3CurveModelPrivate *priv)
+{
+  const Gtk3CurveInterpolator *interp;
+  Gtk3CurvePoints points;
+  Gtk3CurveKnots knots;
+  gfloat prev;
+  gint i, n;
+
+  if (priv->solved_generation == priv->generation)
+    return;
+
+  interp = gtk3_curve_interpolator_get (priv->curve_type);
+
+  if (priv->solved_generation != 0)
+    {
+      if (priv->n_prev_alloc < priv->n_active)
+        {
+          priv->n_prev_alloc = priv->n_solved_alloc;
+          g_free (priv->d_prev);
+          priv->d_prev = g_malloc (4 * priv->n_prev_alloc * sizeof (gfloat));
+        }
+
+      /* only a state prepared for these points has knots */
+      priv->prev_valid =
+        interp->knots != NULL && priv->n_active >= 2 &&
+        priv->solved_layout == priv->layout_generation &&
+        priv->state_generation[priv->curve_type] == priv->solved_generation;
+
+      if (priv->prev_valid)
+        {
+          gtk3_curve_model_points (priv, &points);
+          interp->knots (priv->states[priv->curve_type], &points, &knots);
+
+          memcpy (priv->d_prev, priv->xv, priv->n_active * sizeof (gfloat));
+          memcpy (priv->d_prev + priv->n_prev_alloc, knots.value,
+                  priv->n_active * sizeof (gfloat));
+          if (knots.d_out)
+            {
+              memcpy (priv->d_prev + 2 * priv->n_prev_alloc, knots.d_out,
+                      priv->n_active * sizeof (gfloat));
+              memcpy (priv->d_prev + 3 * priv->n_prev_alloc, knots.d_in,
+                      priv->n_active * sizeof (gfloat));
+            }
+        }
+      priv->n_prev          = priv->n_active;
+      priv->prev_generation = priv->solved_generation;
+      priv->prev_layout     = priv->solved_layout;
+    }
+
+  if (gtk3_curve_model_collect_local (priv))
+    {
+      priv->local_generation = priv->generation;
+    }
+  else
+    {
+      if (priv->n_solved_alloc < priv->n_cpoints)
+        {
+          priv->n_solved_alloc = priv->n_cpoints;
+          g_free (priv->d_solved);
+          priv->d_solved = g_malloc (4 * priv->n_solved_alloc * sizeof (gfloat));
+        }
+      priv->xv = priv->d_solved;
+      priv->yv = priv->d_solved + priv->n_solved_alloc;
+      priv->lv = priv->d_solved + 2 * priv->n_solved_alloc;
+      priv->rv = priv->d_solved + 3 * priv->n_solved_alloc;
+
+      prev = priv->min_x - 1.0;
+      for (i = n = 0; i < priv->n_cpoints; ++i)
+        if (priv->cpx[i] > prev)
+          {
+            prev        = priv->cpx[i];
+            priv->xv[n] = priv->cpx[i];
+            priv->yv[n] = priv->cpy[i];
+            priv->lv[n] = priv->cpl[i];
+            priv->rv[n] = priv->cpr[i];
+            ++n;
+          }
+      priv->n_active = n;
+    }
+
+  priv->solved_generation = priv->generation;
+  priv->solved_layout     = priv->layout_generation;
+
+  gtk3_curve_model_prepare (priv, priv->curve_type);
+}
+
+/* Updates the active points after gtk3_curve_model_set_point or
+ * gtk3_curve_model_set_handles changed one point without reordering the
+ * points.  Returns FALSE if they have to be collected again.  Called from
+ * gtk3_curve_model_solve with the lock held. */
+static gboolean
+gtk3_curve_model_collect_local (Gtk3CurveModelPrivate *priv)
+{
+  gfloat left;
+  gint i, n;
+
+  i = priv->edit_point;
+  n = priv->n_active;
+
+  /* a single edit on a curve whose points were all active */
+  if (priv->edit_generation != priv->generation ||
+      priv->solved_generation != priv->generation - 1 ||
+      priv->solved_layout != priv->layout_generation ||
+      n != priv->n_cpoints || n < 2)
+    return FALSE;
+
+  left = i > 0 ? priv->cpx[i - 1] : priv->min_x - 1.0;
+  if (!(priv->cpx[i] > left) ||
+      (i < n - 1 && !(priv->cpx[i] < priv->cpx[i + 1])))
+    return FALSE;
+
+  priv->xv[i] = priv->cpx[i];
+  priv->yv[i] = priv->cpy[i];
+  priv->lv[i] = priv->cpl[i];
+  priv->rv[i] = priv->cpr[i];
+
+  return TRUE;
+}
+
+/* Brings the state of the interpolator of the given type up to date with
+ * the active points, locally if only one point changed since it was last
+ * prepared.  Called with the lock held, after gtk3_curve_model_solve. */
+static void
+gtk3_curve_model_prepare (Gtk3CurveModelPrivate *priv, Gtk3CurveType type)
+{
+  const Gtk3CurveInterpolator *interp;
+  Gtk3CurvePoints points;
+
+  interp = gtk3_curve_interpolator_get (type);
+
+  if (interp->prepare == NULL || priv->n_active < 2 ||
+      priv->state_generation[type] == priv->generation)
+    return;
+
+  if (priv->states[type] == NULL)
+    priv->states[type] = interp->state_new ();
+
+  gtk3_curve_model_points (priv, &points);
+
+  if (interp->update_local &&
+      priv->local_generation == priv->generation &&
+      priv->state_generation[type] == priv->generation - 1)
+    interp->update_local (priv->states[type], &points, priv->edit_point);
+  else
+    interp->prepare (priv->states[type], &points);
+
+  priv->state_generation[type] = priv->generation;
+}
+
+/* What the interpolators read.  Called with the lock held. */
+static void
+gtk3_curve_model_points (Gtk3CurveModelPrivate *priv, Gtk3CurvePoints *points)
+{
+  points->n         = priv->n_active;
+  points->x         = priv->xv;
+  points->y         = priv->yv;
+  points->l         = priv->lv;
+  points->r         = priv->rv;
+  points->tension   = priv->tension;
+  points->n_samples = priv->n_samples;
+  points->samples   = priv->d_samples;
+  points->params    = priv->params[priv->curve_type];
+  points->min_x     = priv->min_x;
+  points->max_x     = priv->max_x;
+  points->min_y     = priv->min_y;
+  points->max_y     = priv->max_y;
+}
+
+/* The value of a curve type with points that has fewer than two active
+ * ones: that of the one point, or min-y.  Called with the lock held,
+ * after gtk3_curve_model_solve. */
+static gfloat
+gtk3_curve_model_degenerate_value (Gtk3CurveModelPrivate *priv)
+{
+  gfloat ry;
+
+  if (priv->n_active > 0)
+    ry = priv->yv[0];
+  else
+    ry = priv->min_y;
+  if (ry < priv->min_y) ry = priv->min_y;
+  if (ry > priv->max_y) ry = priv->max_y;
+
+  return ry;
+}
+
+/* Evaluates samples start <= i < end of a veclen vector of the curve as
+ * if it were of the given type into vector[i - start].  Only reads the
+ * model, the caller holds the lock and has prepared the interpolator. */
+static void
+gtk3_curve_model_eval_block (Gtk3CurveModelPrivate *priv,
+                             Gtk3CurveType          type,
+                             gint                   veclen,
+                             gint                   start,
+                             gint                   end,
+                             gfloat                 vector[])
+{
+  const Gtk3CurveInterpolator *interp;
+  Gtk3CurvePoints points;
+  gfloat ry;
+  gint x;
+
+  interp = gtk3_curve_interpolator_get (type);
+
+  if (interp->prepare && priv->n_active < 2)
+    {
+      ry = gtk3_curve_model_degenerate_value (priv);
+      for (x = start; x < end; ++x)
+        vector[x - start] = ry;
+      return;
+    }
+
+  gtk3_curve_model_points (priv, &points);
+  points.params = priv->params[type];
+  interp->eval_range (priv->states[type], &points, veclen, start, end, vector);
+}
+
+/* As gtk3_curve_model_eval_block, but into the data or code values of
+ * output, EVAL_BLOCK samples at a time through a buffer.  The analytic
+ * types are only within GTK3_CURVE_ANALYTIC_ERROR, so where that leaves
+ * the rounding to a code value open their exact value decides it. */
+static void
+gtk3_curve_model_eval_blocks (Gtk3CurveModelPrivate *priv,
+                             Gtk3CurveType          type,
+                             gint                   veclen,
+                             gint                   start,
+                             gint                   end,
+                             const EvalOutput      *output)
+{
+  const Gtk3CurveInterpolator *interp;
+  const Gtk3CurveKernels *kernels;
+  Gtk3CurvePoints points;
+  gfloat block[EVAL_BLOCK];
+  gfloat scale, tol, r;
+  gfloat *f;
+  gdouble *d;
+  gdouble rv;
+  gint max_code, i, j, n;
+
+  interp = gtk3_curve_interpolator_get (type);
+  kernels = gtk3_curve_kernels_get ();
+
+  /* a flat y range has no codes to map to but 0, and no scale */
+  if (output->lut_bits > 0 && priv->max_y == priv->min_y)
+    {
+      if (output->lut8)
+        memset (output->lut8 + start, 0, end - start);
+      else
+        memset (output->lut16 + start, 0, (end - start) * sizeof (guint16));
+      return;
+    }
+
+  max_code = (1 << output->lut_bits) - 1;
+  scale = max_code / (priv->max_y - priv->min_y);
+  tol = max_code * (GTK3_CURVE_ANALYTIC_ERROR + FLT_EPSILON);
+
+  gtk3_curve_model_points (priv, &points);
+  points.params = priv->params[type];
+
+  for (i = start; i < end; i += n)
+    {
+      n = MIN (end - i, EVAL_BLOCK);
+
+      /* block[j] is sample i + j */
+      gtk3_curve_model_eval_block (priv, type, veclen, i, i + n, block);
+
+      if (output->lut_bits == 0)
+        {
+          if (output->format == GTK3_CURVE_FORMAT_DOUBLE)
+            {
+              d = (gdouble *) output->data + output->offset + (gsize) i * output->stride;
+              for (j = 0; j < n; ++j)
+                d[(gsize) j * output->stride] = block[j];
+            }
+          else
+            {
+              f = (gfloat *) output->data + output->offset + (gsize) i * output->stride;
+              for (j = 0; j < n; ++j)
+                f[(gsize) j * output->stride] = block[j];
+            }
+          continue;
+        }
+
+      if (output->lut8)
+        kernels->quantize_u8 (block, n, priv->min_y, scale, max_code,
+                              output->lut8 + i);
+      else
+        kernels->quantize_u16 (block, n, priv->min_y, scale, max_code,
+                               output->lut16 + i);
+
+      if (interp->value == NULL)
+        continue;
+
+      for (j = 0; j < n; ++j)
+        {
+          r = (block[j] - priv->min_y) * scale;
+          if (fabsf (r - floorf (r) - 0.5f) >= tol)
+            continue;
+
+          rv = interp->value (&points, (gdouble) (i + j) / (veclen - 1));
+          rv = floor (CLAMP (rv * max_code + 0.5, 0.0, max_code));
+          if (output->lut8)
+            output->lut8[i + j] = rv;
+          else
+            output->lut16[i + j] = rv;
+        }
+    }
+}
+
+static void
+gtk3_curve_model_eval_range (Gtk3CurveModelPrivate *priv,
+                             Gtk3CurveType          type,
+                             gint                   veclen,
+                             gint                   start,
+                             gint                   end,
+                             const EvalOutput      *output)
+{
+  if (output->vector)
+    gtk3_curve_model_eval_block (priv, type, veclen, start, end,
+                                 output->vector + start);
+  else
+    gtk3_curve_model_eval_blocks (priv, type, veclen, start, end, output);
+}
+
+static void
+gtk3_curve_model_eval_chunk (gpointer data, gpointer user_data)
+{
+  EvalChunk *chunk = data;
+  EvalJob *job = chunk->job;
+
+  gtk3_curve_model_eval_range (job->priv, job->type, job->veclen,
+                               chunk->start, chunk->end, job->output);
+
+  g_mutex_lock (&job->lock);
+  if (--job->pending == 0)
+    g_cond_signal (&job->cond);
+  g_mutex_unlock (&job->lock);
+}
+
+/* One pool for all models, sized to the machine.  Returns NULL on a
+ * single processor. */
+static GThreadPool *
+gtk3_curve_model_get_pool (void)
+{
+  static GThreadPool *pool = NULL;
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+      if (g_get_num_processors () > 1)
+        pool = g_thread_pool_new (gtk3_curve_model_eval_chunk, NULL,
+                                  g_get_num_processors (), FALSE, NULL);
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return pool;
+}
+
+/* Evaluates samples start <= i < end of a veclen vector of the curve as
+ * if it were of the given type, into output.  Large ranges are cut into
+ * chunks evaluated in parallel on the shared thread pool, the calling
+ * thread taking the first one.  Called with the lock held, which also
+ * keeps the model unchanged while the chunks run. */
+static void
+gtk3_curve_model_eval_output (Gtk3CurveModelPrivate *priv,
+                              Gtk3CurveType          type,
+                              gint                   veclen,
+                              gint                   start,
+                              gint                   end,
+                              const EvalOutput      *output)
+{
+  GThreadPool *pool;
+  EvalChunk *chunks;
+  EvalJob job;
+  gint x, n_chunks, size;
+
+  if (gtk3_curve_interpolator_get (type)->prepare)
+    {
+      gtk3_curve_model_solve (priv);
+      gtk3_curve_model_prepare (priv, type);
+    }
+
+  pool = NULL;
+  n_chunks = 1;
+  if (end - start >= PARALLEL_MIN_SAMPLES)
+    {
+      pool = gtk3_curve_model_get_pool ();
+      if (pool)
+        n_chunks = MIN ((gint) g_get_num_processors (),
+                        (end - start) / PARALLEL_MIN_CHUNK);
+    }
+
+  if (n_chunks < 2)
+    {
+      gtk3_curve_model_eval_range (priv, type, veclen, start, end, output);
+      return;
+    }
+
+  /* chunks are a multiple of 8 long so the kernels stay on full vectors */
+  size = ((end - start + n_chunks - 1) / n_chunks + 7) & ~7;
+
+  job.priv    = priv;
+  job.type    = type;
+  job.veclen  = veclen;
+  job.output  = output;
+  job.pending = n_chunks - 1;
+  g_mutex_init (&job.lock);
+  g_cond_init (&job.cond);
+
+  chunks = g_new (EvalChunk, n_chunks);
+  for (x = 0; x < n_chunks; ++x)
+    {
+      chunks[x].job   = &job;
+      chunks[x].start = MIN (start + x * size, end);
+      chunks[x].end   = MIN (start + (x + 1) * size, end);
+      if (x > 0)
+        g_thread_pool_push (pool, &chunks[x], NULL);
+    }
+
+  gtk3_curve_model_eval_range (priv, type, veclen,
+                               chunks[0].start, chunks[0].end, output);
+
+  g_mutex_lock (&job.lock);
+  while (job.pending > 0)
+    g_cond_wait (&job.cond, &job.lock);
+  g_mutex_unlock (&job.lock);
+
+  g_mutex_clear (&job.lock);
+  g_cond_clear (&job.cond);
+  g_free (chunks);
+}
+
+/* gtk3_curve_model_eval_output into vector. */
+static void
+gtk3_curve_model_eval_vector (Gtk3CurveModelPrivate *priv,
+                              Gtk3CurveType          type,
+                              gint                   veclen,
+                              gint                   start,
+                              gint                   end,
+                              gfloat                 vector[])
+{
+  EvalOutput output = { 0 };
+
+  output.vector = vector;
+  gtk3_curve_model_eval_output (priv, type, veclen, start, end, &output);
+}
+
+/* Evaluates the curve at the positions x[j], j < n, into y[j].  Analytic
+ * types are computed from their exact value, and hold their end values
+ * outside [min-x, max-x].  Called with the lock held. */
+static void
+gtk3_curve_model_eval_at (Gtk3CurveModelPrivate *priv,
+                          const gfloat           x[],
+                          gfloat                 y[],
+                          gint                   n)
+{
+  const Gtk3CurveInterpolator *interp;
+  Gtk3CurvePoints points;
+  gboolean sorted;
+  gdouble u, ry;
+  gint j;
+
+  interp = gtk3_curve_interpolator_get (priv->curve_type);
+
+  if (interp->prepare)
+    {
+      gtk3_curve_model_solve (priv);
+      gtk3_curve_model_prepare (priv, priv->curve_type);
+
+      if (priv->n_active < 2)
+        {
+          ry = gtk3_curve_model_degenerate_value (priv);
+          for (j = 0; j < n; ++j)
+            y[j] = ry;
+          return;
+        }
+    }
+
+  gtk3_curve_model_points (priv, &points);
+
+  if (interp->eval_points)
+    {
+      sorted = TRUE;
+      for (j = 1; j < n && sorted; ++j)
+        sorted = x[j] >= x[j - 1];
+
+      interp->eval_points (priv->states[priv->curve_type], &points,
+                           x, y, n, sorted);
+      return;
+    }
+
+  for (j = 0; j < n; ++j)
+    {
+      u = (x[j] - priv->min_x) / (gdouble) (priv->max_x - priv->min_x);
+      u = CLAMP (u, 0.0, 1.0);
+      ry = priv->min_y + (priv->max_y - priv->min_y) * interp->value (&points, u);
+      y[j] = CLAMP (ry, priv->min_y, priv->max_y);
+    }
+}
+
+/* Finds the samples of a veclen vector that changed since generation
+ * since.  Returns FALSE when that is unknown: the range or type changed,
+ * points were added or removed, or more than the last solve separates
+ * since from now.  Otherwise samples outside [start, end) changed by at
+ * most error.  Linear and free form curves are exact (error 0).  A spline
+ * edit changes every span a little; spans whose change is bounded by
+ * tolerance are left out and the largest such bound is returned in
+ * error.  Called with the lock held. */
+static gboolean
+gtk3_curve_model_dirty (Gtk3CurveModelPrivate *priv,
+                        guint                  since,
+                        gint                   veclen,
+                        gfloat                 tolerance,
+                        gint                  *start,
+                        gint                  *end,
+                        gfloat                *error)
+{
+  gfloat dx, lo, hi;
+
+  *start = *end = 0;
+  *error = 0.0;
+
+  if (since == priv->generation)
+    return TRUE;
+
+  if (priv->curve_type == GTK3_CURVE_TYPE_FREE)
+    {
+      if (priv->free_generation != priv->generation ||
+          since != priv->generation - 1)
+        return FALSE;
+
+      /* sample i reads free form sample i * n_samples / veclen */
+      *start = ((gint64) priv->free_start * veclen + priv->n_samples - 1)
+               / priv->n_samples;
+      *end = ((gint64) priv->free_end * veclen + priv->n_samples - 1)
+             / priv->n_samples;
+      return TRUE;
+    }
+
+  dx = (priv->max_x - priv->min_x) / (veclen - 1);
+  if (!(dx > 0.0) ||
+      !gtk3_curve_model_dirty_span (priv, since, tolerance, &lo, &hi, error))
+    return FALSE;
+
+  if (lo > hi)
+    return TRUE;
+
+  *start = gtk3_curve_sample_bound (priv->min_x, dx, 0, veclen, lo, FALSE);
+  *end = gtk3_curve_sample_bound (priv->min_x, dx, *start, veclen, hi, TRUE);
+
+  return TRUE;
+}
+
+/* The x interval [lo, hi] of a curve of control points that changed
+ * since revision since, leaving out spans with derivatives that moved by
+ * no more than tolerance, the largest of which goes to error.  It is
+ * unbounded on a side whose end span changed if the values beyond the
+ * knots follow it.  lo > hi if nothing did.  Returns FALSE if the change
+ * is not known.  Called with the lock held. */
+static gboolean
+gtk3_curve_model_dirty_span (Gtk3CurveModelPrivate *priv,
+                             guint                  since,
+                             gfloat                 tolerance,
+                             gfloat                *lo,
+                             gfloat                *hi,
+                             gfloat                *error)
+{
+  const Gtk3CurveInterpolator *interp;
+  Gtk3CurvePoints points;
+  Gtk3CurveKnots knots;
+  const gfloat *x, *px, *py, *pd0, *pd1;
+  gfloat bound, h;
+  gboolean edges, dirty;
+  gint k, n;
+
+  *lo = G_MAXFLOAT;
+  *hi = -G_MAXFLOAT;
+  *error = 0.0;
+
+  gtk3_curve_model_solve (priv);
+
+  interp = gtk3_curve_interpolator_get (priv->curve_type);
+
+  if (!priv->prev_valid ||
+      priv->prev_generation != since ||
+      priv->prev_layout != priv->solved_layout ||
+      priv->n_prev != priv->n_active ||
+      priv->n_active < 2)
+    return FALSE;
+
+  gtk3_curve_model_points (priv, &points);
+  interp->knots (priv->states[priv->curve_type], &points, &knots);
+
+  n   = priv->n_active;
+  x   = priv->xv;
+  px  = priv->d_prev;
+  py  = priv->d_prev + priv->n_prev_alloc;
+  pd0 = priv->d_prev + 2 * priv->n_prev_alloc;
+  pd1 = priv->d_prev + 3 * priv->n_prev_alloc;
+
+  edges = (interp->flags & GTK3_CURVE_INTERP_EDGES) != 0;
+  dirty = FALSE;
+
+  for (k = 0; k < n - 1; ++k)
+    {
+      if (x[k] != px[k] || x[k + 1] != px[k + 1])
+        bound = G_MAXFLOAT;
+      else
+        {
+          bound = MAX (fabs (knots.value[k] - py[k]),
+                       fabs (knots.value[k + 1] - py[k + 1]));
+          if (knots.d_out)
+            {
+              h = x[k + 1] - x[k];
+              bound += (fabs (knots.d_out[k] - pd0[k]) +
+                        fabs (knots.d_in[k + 1] - pd1[k + 1]))
+                       * (knots.order == 2 ? h * h : h) * knots.weight;
+            }
+        }
+
+      if (bound == 0.0)
+        continue;
+
+      /* values only depending on the knots are exact; beyond the end
+       * knots the bound does not hold */
+      if (knots.d_out && bound <= tolerance && k > 0 && k < n - 2)
+        {
+          *error = MAX (*error, bound);
+          continue;
+        }
+
+      if (!dirty)
+        *lo = (edges && k == 0) ? -G_MAXFLOAT : MIN (x[k], px[k]);
+      *hi = (edges && k == n - 2) ? G_MAXFLOAT : MAX (x[k + 1], px[k + 1]);
+      dirty = TRUE;
+    }
+
+  return TRUE;
+}
+
+/*                          =====================                           */
+/* =========================== PUBLIC FUNCTIONS =========================== */
+/*                          =====================                           */
+
+void
+gtk3_curve_model_reset (Gtk3CurveModel *model)
+{
+  Gtk3CurveModelPrivate *priv;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+
+  gtk3_curve_model_default_points (priv);
+  gtk3_curve_model_default_params (priv);
+  priv->generation++;
+
+  if (priv->curve_type == GTK3_CURVE_TYPE_FREE)
+    gtk3_curve_model_sample (priv, GTK3_CURVE_TYPE_LINEAR);
+
+  g_mutex_unlock (&priv->lock);
+
+  DEBUG_INFO("model reset\n");
+
+  gtk3_curve_model_emit_changed (model);
+}
+
+void
+gtk3_curve_model_set_range (Gtk3CurveModel *model,
+                            gfloat          min_x,
+                            gfloat          max_x,
+                            gfloat          min_y,
+                            gfloat          max_y)
+{
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+
+  gtk3_curve_model_update_range (model, min_x, max_x, min_y, max_y, 0);
+}
+
+/* gtk3_curve_model_set_range, but not notifying range property
+ * PROP_MIN_X + i if bit i of notified is set */
+static void
+gtk3_curve_model_update_range (Gtk3CurveModel *model,
+                               gfloat          min_x,
+                               gfloat          max_x,
+                               gfloat          min_y,
+                               gfloat          max_y,
+                               guint           notified)
+{
+  Gtk3CurveModelPrivate *priv = model->priv;
+  gboolean changed_min_x, changed_max_x, changed_min_y, changed_max_y;
+
+  g_mutex_lock (&priv->lock);
+
+  changed_min_x = priv->min_x != min_x;
+  changed_max_x = priv->max_x != max_x;
+  changed_min_y = priv->min_y != min_y;
+  changed_max_y = priv->max_y != max_y;
+
+  priv->min_x = min_x;
+  priv->max_x = max_x;
+  priv->min_y = min_y;
+  priv->max_y = max_y;
+
+  if (!changed_min_x && !changed_max_x && !changed_min_y && !changed_max_y)
+    {
+      g_mutex_unlock (&priv->lock);
+      return;
+    }
+  priv->generation++;
+  priv->layout_generation = priv->generation;
+
+  g_mutex_unlock (&priv->lock);
+
+  g_object_freeze_notify (G_OBJECT (model));
+  if (changed_min_x && !(notified & 1))
+    g_object_notify (G_OBJECT (model), "min-x");
+  if (changed_max_x && !(notified & 2))
+    g_object_notify (G_OBJECT (model), "max-x");
+  if (changed_min_y && !(notified & 4))
+    g_object_notify (G_OBJECT (model), "min-y");
+  if (changed_max_y && !(notified & 8))
+    g_object_notify (G_OBJECT (model), "max-y");
+  g_object_thaw_notify (G_OBJECT (model));
+
+  gtk3_curve_model_emit_changed (model);
+}
+
+void
+gtk3_curve_model_get_range (Gtk3CurveModel *model,
+                            gfloat         *min_x,
+                            gfloat         *max_x,
+                            gfloat         *min_y,
+                            gfloat         *max_y)
+{
+  Gtk3CurveModelPrivate *priv;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+  if (min_x)
+    *min_x = priv->min_x;
+  if (max_x)
+    *max_x = priv->max_x;
+  if (min_y)
+    *min_y = priv->min_y;
+  if (max_y)
+    *max_y = priv->max_y;
+  g_mutex_unlock (&priv->lock);
+}
+
+void
+gtk3_curve_model_set_curve_type (Gtk3CurveModel *model,
+                                 Gtk3CurveType   new_type)
+{
+  Gtk3CurveModelPrivate *priv;
+  Gtk3CurveInterpFlags old_flags, new_flags;
+  gfloat rx, dx;
+  gint x, i;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  g_return_if_fail (new_type >= 0 && new_type < GTK3_CURVE_N_TYPES);
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+
+  if (new_type == priv->curve_type)
+    {
+      g_mutex_unlock (&priv->lock);
+      return;
+    }
+
+  old_flags = gtk3_curve_interpolator_get (priv->curve_type)->flags;
+  new_flags = gtk3_curve_interpolator_get (new_type)->flags;
+
+  /* curves of points, drawn ones and analytic ones: a drawn curve
+   * starts from the old one, a curve of points from points on it;
+   * analytic curves keep their parameters */
+  if (new_flags & GTK3_CURVE_INTERP_SAMPLES)
+    {
+      gtk3_curve_model_sample (priv, priv->curve_type);
+    }
+  else if ((new_flags & GTK3_CURVE_INTERP_POINTS) &&
+           !(old_flags & GTK3_CURVE_INTERP_POINTS) &&
+           (priv->d_samples || !(old_flags & GTK3_CURVE_INTERP_SAMPLES)))
+    {
+      gtk3_curve_model_reserve (priv, N_FREE_CPOINTS);
+      priv->n_cpoints = N_FREE_CPOINTS;
+
+      if (!(old_flags & GTK3_CURVE_INTERP_SAMPLES))
+        gtk3_curve_model_eval_vector (priv, priv->curve_type, priv->n_cpoints,
+                                      0, priv->n_cpoints, priv->cpy);
+
+      rx = 0.0;
+      dx = (priv->n_samples - 1) / (gfloat) (priv->n_cpoints - 1);
+
+      for (i = 0; i < priv->n_cpoints; ++i, rx += dx)
+        {
+          x = (int) (rx + 0.5);
+          priv->cpx[i] = priv->min_x + (priv->max_x - priv->min_x) *
+                         i / (gfloat) (priv->n_cpoints - 1);
+          if (old_flags & GTK3_CURVE_INTERP_SAMPLES)
+            priv->cpy[i] = priv->d_samples[x];
+          priv->cpl[i] = priv->cpr[i] = NAN;
+        }
+    }
+  priv->curve_type = new_type;
+  priv->generation++;
+  priv->layout_generation = priv->generation;
+
+  g_mutex_unlock (&priv->lock);
+
+  DEBUG_INFO("model set curve type\n");
+
+  g_object_notify (G_OBJECT (model), "curve-type");
+  gtk3_curve_model_emit_changed (model);
+}
+
+Gtk3CurveType
+gtk3_curve_model_get_curve_type (Gtk3CurveModel *model)
+{
+  Gtk3CurveType type;
+
+  g_return_val_if_fail (GTK3_IS_CURVE_MODEL (model), GTK3_CURVE_TYPE_SPLINE);
+
+  g_mutex_lock (&model->priv->lock);
+  type = model->priv->curve_type;
+  g_mutex_unlock (&model->priv->lock);
+
+  return type;
+}
+
+gint
+gtk3_curve_model_get_n_points (Gtk3CurveModel *model)
+{
+  gint n;
+
+  g_return_val_if_fail (GTK3_IS_CURVE_MODEL (model), 0);
+
+  g_mutex_lock (&model->priv->lock);
+  n = model->priv->n_cpoints;
+  g_mutex_unlock (&model->priv->lock);
+
+  return n;
+}
+
+gboolean
+gtk3_curve_model_get_point (Gtk3CurveModel *model,
+                            gint            index,
+                            gfloat         *x,
+                            gfloat         *y)
+{
+  Gtk3CurveModelPrivate *priv;
+  gboolean valid;
+
+  g_return_val_if_fail (GTK3_IS_CURVE_MODEL (model), FALSE);
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+  valid = index >= 0 && index < priv->n_cpoints;
+  if (valid)
+    {
+      if (x)
+        *x = priv->cpx[index];
+      if (y)
+        *y = priv->cpy[index];
+    }
+  g_mutex_unlock (&priv->lock);
+
+  return valid;
+}
+
+/* Points moved below min-x become inactive: they are skipped by the
+ * evaluation until gtk3_curve_model_remove_inactive_points drops them. */
+void
+gtk3_curve_model_set_point (Gtk3CurveModel *model,
+                            gint            index,
+                            gfloat          x,
+                            gfloat          y)
+{
+  Gtk3CurveModelPrivate *priv;
+  gboolean changed = FALSE;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+  if (index >= 0 && index < priv->n_cpoints &&
+      (priv->cpx[index] != x || priv->cpy[index] != y))
+    {
+      priv->cpx[index] = x;
+      priv->cpy[index] = y;
+      priv->generation++;
+      priv->edit_generation = priv->generation;
+      priv->edit_point = index;
+      changed = TRUE;
+    }
+  g_mutex_unlock (&priv->lock);
+
+  if (changed)
+    gtk3_curve_model_emit_changed (model);
+}
+
+void
+gtk3_curve_model_insert_point (Gtk3CurveModel *model,
+                               gint            index,
+                               gfloat          x,
+                               gfloat          y)
+{
+  Gtk3CurveModelPrivate *priv;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+
+  index = CLAMP (index, 0, priv->n_cpoints);
+
+  gtk3_curve_model_reserve (priv, priv->n_cpoints + 1);
+  memmove (priv->cpx + index + 1, priv->cpx + index,
+           (priv->n_cpoints - index) * sizeof (gfloat));
+  memmove (priv->cpy + index + 1, priv->cpy + index,
+           (priv->n_cpoints - index) * sizeof (gfloat));
+  memmove (priv->cpl + index + 1, priv->cpl + index,
+           (priv->n_cpoints - index) * sizeof (gfloat));
+  memmove (priv->cpr + index + 1, priv->cpr + index,
+           (priv->n_cpoints - index) * sizeof (gfloat));
+  ++priv->n_cpoints;
+  priv->cpx[index] = x;
+  priv->cpy[index] = y;
+  priv->cpl[index] = priv->cpr[index] = NAN;
+  priv->generation++;
+
+  g_mutex_unlock (&priv->lock);
+
+  gtk3_curve_model_emit_changed (model);
+}
+
+void
+gtk3_curve_model_remove_inactive_points (Gtk3CurveModel *model)
+{
+  Gtk3CurveModelPrivate *priv;
+  gint src, dst;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+
+  for (src = dst = 0; src < priv->n_cpoints; ++src)
+    {
+      if (priv->cpx[src] >= priv->min_x)
+        {
+          priv->cpx[dst] = priv->cpx[src];
+          priv->cpy[dst] = priv->cpy[src];
+          priv->cpl[dst] = priv->cpl[src];
+          priv->cpr[dst] = priv->cpr[src];
+          ++dst;
+        }
+    }
+
+  if (dst == src)
+    {
+      g_mutex_unlock (&priv->lock);
+      return;
+    }
+
+  priv->n_cpoints = dst;
+  if (priv->n_cpoints <= 0)
+    {
+      priv->n_cpoints = 1;
+      priv->cpx[0] = priv->min_x;
+      priv->cpy[0] = priv->min_y;
+      priv->cpl[0] = priv->cpr[0] = NAN;
+    }
+  priv->generation++;
+
+  g_mutex_unlock (&priv->lock);
+
+  gtk3_curve_model_emit_changed (model);
+}
+
+/* Replaces all control points at once, with automatic handles.  Points
+ * whose x does not increase are kept but inactive, as with
+ * gtk3_curve_model_set_point.  A free form curve keeps its samples;
+ * leaving free form makes new points from them. */
+void
+gtk3_curve_model_set_points (Gtk3CurveModel        *model,
+                             gint                   n_points,
+                             const Gtk3CurveVector  points[])
+{
+  Gtk3CurveModelPrivate *priv;
+  gint i;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  g_return_if_fail (n_points > 0);
+  g_return_if_fail (points != NULL);
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+
+  gtk3_curve_model_reserve (priv, n_points);
+  for (i = 0; i < n_points; ++i)
+    {
+      priv->cpx[i] = points[i].x;
+      priv->cpy[i] = points[i].y;
+      priv->cpl[i] = priv->cpr[i] = NAN;
+    }
+  priv->n_cpoints = n_points;
+  priv->generation++;
+
+  g_mutex_unlock (&priv->lock);
+
+  DEBUG_INFO("model set points\n");
+
+  gtk3_curve_model_emit_changed (model);
+}
+
+/* Copies up to n_points control points to points and returns how many
+ * there are, so a first call with n_points 0 tells how much room to make. */
+gint
+gtk3_curve_model_get_points (Gtk3CurveModel  *model,
+                             gint             n_points,
+                             Gtk3CurveVector  points[])
+{
+  Gtk3CurveModelPrivate *priv;
+  gint i, n;
+
+  g_return_val_if_fail (GTK3_IS_CURVE_MODEL (model), 0);
+  g_return_val_if_fail (n_points <= 0 || points != NULL, 0);
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+  n = priv->n_cpoints;
+  for (i = 0; i < MIN (n, n_points); ++i)
+    {
+      points[i].x = priv->cpx[i];
+      points[i].y = priv->cpy[i];
+    }
+  g_mutex_unlock (&priv->lock);
+
+  return n;
+}
+
+/* Sets the Bezier handles of a control point as the slopes of the curve
+ * into (in_slope) and out of (out_slope) the point; each handle sits a
+ * third of the way to the neighbouring point.  NAN makes a handle
+ * automatic, following the Catmull-Rom tangent.  Only Bezier curves use
+ * them. */
+void
+gtk3_curve_model_set_handles (Gtk3CurveModel *model,
+                              gint            index,
+                              gfloat          in_slope,
+                              gfloat          out_slope)
+{
+  Gtk3CurveModelPrivate *priv;
+  gboolean changed = FALSE;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+  if (index >= 0 && index < priv->n_cpoints &&
+      (memcmp (&priv->cpl[index], &in_slope, sizeof (gfloat)) != 0 ||
+       memcmp (&priv->cpr[index], &out_slope, sizeof (gfloat)) != 0))
+    {
+      priv->cpl[index] = in_slope;
+      priv->cpr[index] = out_slope;
+      priv->generation++;
+      priv->edit_generation = priv->generation;
+      priv->edit_point = index;
+      changed = TRUE;
+    }
+  g_mutex_unlock (&priv->lock);
+
+  if (changed)
+    gtk3_curve_model_emit_changed (model);
+}
+
+gboolean
+gtk3_curve_model_get_handles (Gtk3CurveModel *model,
+                              gint            index,
+                              gfloat         *in_slope,
+                              gfloat         *out_slope)
+{
+  Gtk3CurveModelPrivate *priv;
+  gboolean valid;
+
+  g_return_val_if_fail (GTK3_IS_CURVE_MODEL (model), FALSE);
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+  valid = index >= 0 && index < priv->n_cpoints;
+  if (valid)
+    {
+      if (in_slope)
+        *in_slope = priv->cpl[index];
+      if (out_slope)
+        *out_slope = priv->cpr[index];
+    }
+  g_mutex_unlock (&priv->lock);
+
+  return valid;
+}
+
+void
+gtk3_curve_model_set_tension (Gtk3CurveModel *model,
+                              gfloat          tension)
+{
+  Gtk3CurveModelPrivate *priv;
+  gboolean changed;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  priv = model->priv;
+
+  tension = CLAMP (tension, 0.0, 1.0);
+
+  g_mutex_lock (&priv->lock);
+
+  if (tension == priv->tension)
+    {
+      g_mutex_unlock (&priv->lock);
+      return;
+    }
+  priv->tension = tension;
+
+  changed = (gtk3_curve_interpolator_get (priv->curve_type)->flags &
+             GTK3_CURVE_INTERP_TENSION) != 0;
+  if (changed)
+    {
+      priv->generation++;
+      priv->layout_generation = priv->generation;
+    }
+
+  g_mutex_unlock (&priv->lock);
+
+  g_object_notify (G_OBJECT (model), "tension");
+  if (changed)
+    gtk3_curve_model_emit_changed (model);
+}
+
+gfloat
+gtk3_curve_model_get_tension (Gtk3CurveModel *model)
+{
+  gfloat tension;
+
+  g_return_val_if_fail (GTK3_IS_CURVE_MODEL (model), 0.0);
+
+  g_mutex_lock (&model->priv->lock);
+  tension = model->priv->tension;
+  g_mutex_unlock (&model->priv->lock);
+
+  return tension;
+}
+
+/* Draws a straight segment into the free form curve, as done with the
+ * pencil.  Coordinates are in curve units. */
+void
+gtk3_curve_model_set_free_segment (Gtk3CurveModel *model,
+                                   gfloat          x1,
+                                   gfloat          y1,
+                                   gfloat          x2,
+                                   gfloat          y2)
+{
+  Gtk3CurveModelPrivate *priv;
+  gfloat scale, y;
+  gint i, i1, i2;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+
+  if (priv->d_samples == NULL)
+    gtk3_curve_model_sample (priv, priv->curve_type);
+
+  if (x1 > x2)
+    {
+      gfloat t;
+      t = x1; x1 = x2; x2 = t;
+      t = y1; y1 = y2; y2 = t;
+    }
+
+  scale = (priv->n_samples - 1) / (priv->max_x - priv->min_x);
+  i1 = CLAMP ((gint) ((x1 - priv->min_x) * scale + 0.5), 0, priv->n_samples - 1);
+  i2 = CLAMP ((gint) ((x2 - priv->min_x) * scale + 0.5), 0, priv->n_samples - 1);
+
+  for (i = i1; i <= i2; i++)
+    {
+      if (i2 != i1)
+        y = y1 + ((y2 - y1) * (i - i1)) / (i2 - i1);
+      else
+        y = y2;
+      priv->d_samples[i] = CLAMP (y, priv->min_y, priv->max_y);
+    }
+  priv->generation++;
+  priv->free_generation = priv->generation;
+  priv->free_start = i1;
+  priv->free_end = i2 + 1;
+
+  g_mutex_unlock (&priv->lock);
+
+  gtk3_curve_model_emit_changed (model);
+}
+
+/* Makes the curve analytic of the given type, with its first n_params
+ * parameters set from params and the others kept.  See the curve types
+ * for what the parameters are. */
+void
+gtk3_curve_model_set_parameters (Gtk3CurveModel *model,
+                                 Gtk3CurveType   type,
+                                 gint            n_params,
+                                 const gfloat    params[])
+{
+  Gtk3CurveModelPrivate *priv;
+  Gtk3CurveType old_type;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  g_return_if_fail (type >= 0 && type < GTK3_CURVE_N_TYPES);
+  g_return_if_fail (gtk3_curve_interpolator_get (type)->n_params > 0);
+  g_return_if_fail (n_params >= 0);
+  g_return_if_fail (n_params == 0 || params != NULL);
+  priv = model->priv;
+
+  n_params = MIN (n_params, gtk3_curve_interpolator_get (type)->n_params);
+
+  g_mutex_lock (&priv->lock);
+
+  old_type = priv->curve_type;
+  priv->curve_type = type;
+  if (n_params > 0)
+    memcpy (priv->params[type], params, n_params * sizeof (gfloat));
+  priv->generation++;
+  priv->layout_generation = priv->generation;
+
+  g_mutex_unlock (&priv->lock);
+
+  DEBUG_INFO("model set parameters\n");
+
+  if (old_type != type)
+    g_object_notify (G_OBJECT (model), "curve-type");
+  gtk3_curve_model_emit_changed (model);
+}
+
+/* Copies up to n_params parameters of the analytic curve type to params
+ * and returns how many it has. */
+gint
+gtk3_curve_model_get_parameters (Gtk3CurveModel *model,
+                                 Gtk3CurveType   type,
+                                 gint            n_params,
+                                 gfloat          params[])
+{
+  gint n;
+
+  g_return_val_if_fail (GTK3_IS_CURVE_MODEL (model), 0);
+  g_return_val_if_fail (type >= 0 && type < GTK3_CURVE_N_TYPES, 0);
+  g_return_val_if_fail (n_params >= 0, 0);
+  g_return_val_if_fail (n_params == 0 || params != NULL, 0);
+
+  n = gtk3_curve_interpolator_get (type)->n_params;
+
+  if (MIN (n, n_params) > 0)
+    {
+      g_mutex_lock (&model->priv->lock);
+      memcpy (params, model->priv->params[type], MIN (n, n_params) * sizeof (gfloat));
+      g_mutex_unlock (&model->priv->lock);
+    }
+
+  return n;
+}
+
+void
+gtk3_curve_model_set_gamma (Gtk3CurveModel *model, gfloat gamma)
+{
+  gtk3_curve_model_set_parameters (model, GTK3_CURVE_TYPE_GAMMA, 1, &gamma);
+}
+
+void
+gtk3_curve_model_set_sigmoid (Gtk3CurveModel *model,
+                              gfloat          contrast,
+                              gfloat          midpoint)
+{
+  gfloat params[2] = { contrast, midpoint };
+
+  gtk3_curve_model_set_parameters (model, GTK3_CURVE_TYPE_SIGMOID, 2, params);
+}
+
+void
+gtk3_curve_model_set_log (Gtk3CurveModel *model, gfloat strength)
+{
+  gtk3_curve_model_set_parameters (model, GTK3_CURVE_TYPE_LOG, 1, &strength);
+}
+
+void
+gtk3_curve_model_set_power (Gtk3CurveModel *model,
+                            gfloat          exponent,
+                            gfloat          gain,
+                            gfloat          offset)
+{
+  gfloat params[3] = { exponent, gain, offset };
+
+  gtk3_curve_model_set_parameters (model, GTK3_CURVE_TYPE_POWER, 3, params);
+}
+
+void
+gtk3_curve_model_set_transfer (Gtk3CurveModel    *model,
+                               Gtk3CurveTransfer  transfer)
+{
+  gfloat param = transfer;
+
+  g_return_if_fail (transfer >= GTK3_CURVE_TRANSFER_SRGB &&
+                    transfer <= GTK3_CURVE_TRANSFER_HLG_INVERSE);
+
+  gtk3_curve_model_set_parameters (model, GTK3_CURVE_TYPE_TRANSFER, 1, &param);
+}
+
+void
+gtk3_curve_model_get_vector (Gtk3CurveModel *model,
+                             gint            veclen,
+                             gfloat          vector[])
+{
+  Gtk3CurveModelPrivate *priv;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  g_return_if_fail (veclen > 1);
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+  gtk3_curve_model_eval_vector (priv, priv->curve_type, veclen, 0, veclen, vector);
+  g_mutex_unlock (&priv->lock);
+}
+
+/* Fills vector[start] to vector[end - 1] with the values
+ * gtk3_curve_model_get_vector would put there. */
+void
+gtk3_curve_model_get_vector_range (Gtk3CurveModel *model,
+                                   gint            veclen,
+                                   gint            start,
+                                   gint            end,
+                                   gfloat          vector[])
+{
+  Gtk3CurveModelPrivate *priv;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  g_return_if_fail (veclen > 1);
+  g_return_if_fail (start >= 0 && start <= end && end <= veclen);
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+  gtk3_curve_model_eval_vector (priv, priv->curve_type, veclen, start, end,
+                                vector);
+  g_mutex_unlock (&priv->lock);
+}
+
+/* Evaluates the curve at the n positions x into y, clamped to [min-y,
+ * max-y].  Positions in increasing order are found by walking the spans
+ * along with them, others by a search each. */
+void
+gtk3_curve_model_eval_points (Gtk3CurveModel *model,
+                              const gfloat    x[],
+                              gfloat          y[],
+                              gint            n)
+{
+  Gtk3CurveModelPrivate *priv;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  g_return_if_fail (n >= 0);
+  g_return_if_fail (n == 0 || (x != NULL && y != NULL));
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+  gtk3_curve_model_eval_at (priv, x, y, n);
+  g_mutex_unlock (&priv->lock);
+}
+
+/* The curve at x.  The solved points and interpolator state are kept
+ * between calls, so while the curve is unchanged this only costs
+ * finding the span. */
+gfloat
+gtk3_curve_model_eval (Gtk3CurveModel *model,
+                       gfloat          x)
+{
+  Gtk3CurveModelPrivate *priv;
+  gfloat y;
+
+  g_return_val_if_fail (GTK3_IS_CURVE_MODEL (model), 0.0);
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+  gtk3_curve_model_eval_at (priv, &x, &y, 1);
+  g_mutex_unlock (&priv->lock);
+
+  return y;
+}
+
+/* As gtk3_curve_model_get_vector, but sample i goes to element offset +
+ * i * stride of data, a float or a double as format says, so one curve
+ * of an interleaved table is filled in place.  Doubles hold the same
+ * values as the floats. */
+void
+gtk3_curve_model_get_vector_full (Gtk3CurveModel  *model,
+                                  gint             veclen,
+                                  Gtk3CurveFormat  format,
+                                  gpointer         data,
+                                  gint             offset,
+                                  gint             stride)
+{
+  Gtk3CurveModelPrivate *priv;
+  EvalOutput output = { 0 };
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  g_return_if_fail (veclen > 1);
+  g_return_if_fail (format == GTK3_CURVE_FORMAT_FLOAT ||
+                    format == GTK3_CURVE_FORMAT_DOUBLE);
+  g_return_if_fail (data != NULL);
+  g_return_if_fail (offset >= 0 && stride >= 1);
+  priv = model->priv;
+
+  if (format == GTK3_CURVE_FORMAT_FLOAT && stride == 1)
+    output.vector = (gfloat *) data + offset;
+  else
+    {
+      output.format = format;
+      output.data   = data;
+      output.offset = offset;
+      output.stride = stride;
+    }
+
+  g_mutex_lock (&priv->lock);
+  gtk3_curve_model_eval_output (priv, priv->curve_type, veclen,
+                                0, veclen, &output);
+  g_mutex_unlock (&priv->lock);
+}
+
+/* Fills lut with the curve as a table of 8 bit code values: lut[i] is
+ * sample i of a 256 sample vector, with [min-y, max-y] mapped to 0 to
+ * 255 and rounded to nearest, halves up.  A flat y range is all 0. */
+void
+gtk3_curve_model_get_lut_u8 (Gtk3CurveModel *model,
+                             guint8          lut[256])
+{
+  Gtk3CurveModelPrivate *priv;
+  EvalOutput output = { 0 };
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  g_return_if_fail (lut != NULL);
+  priv = model->priv;
+
+  output.lut_bits = 8;
+  output.lut8 = lut;
+
+  g_mutex_lock (&priv->lock);
+  gtk3_curve_model_eval_output (priv, priv->curve_type, 256, 0, 256, &output);
+  g_mutex_unlock (&priv->lock);
+}
+
+/* As gtk3_curve_model_get_lut_u8 for code values of 1 to 16 bits, 2^bits
+ * of them, each in the low bits of a guint16; bits is 16 for a full 16
+ * bit table, 10 or 12 for the packed video depths. */
+void
+gtk3_curve_model_get_lut_u16 (Gtk3CurveModel *model,
+                              gint            bits,
+                              guint16         lut[])
+{
+  Gtk3CurveModelPrivate *priv;
+  EvalOutput output = { 0 };
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  g_return_if_fail (bits >= 1 && bits <= 16);
+  g_return_if_fail (lut != NULL);
+  priv = model->priv;
+
+  output.lut_bits = bits;
+  output.lut16 = lut;
+
+  g_mutex_lock (&priv->lock);
+  gtk3_curve_model_eval_output (priv, priv->curve_type, 1 << bits,
+                                0, 1 << bits, &output);
+  g_mutex_unlock (&priv->lock);
+}
+
+/* Tells which part of [min-x, max-x] changed since revision since: it
+ * is [x1, x2], empty if x1 > x2.  Returns FALSE if that is not known,
+ * then anything may have.  Free form curves are resampled by index, so
+ * a vector with fewer samples than the free form curve may see a change
+ * up to one of its samples right of x2. */
+gboolean
+gtk3_curve_model_get_dirty_interval (Gtk3CurveModel *model,
+                                     guint           since,
+                                     gfloat         *x1,
+                                     gfloat         *x2)
+{
+  Gtk3CurveModelPrivate *priv;
+  gfloat lo, hi, error, scale;
+  gboolean known;
+
+  g_return_val_if_fail (GTK3_IS_CURVE_MODEL (model), FALSE);
+  g_return_val_if_fail (x1 != NULL && x2 != NULL, FALSE);
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+
+  if (since == priv->generation)
+    {
+      known = TRUE;
+      lo = G_MAXFLOAT;
+      hi = -G_MAXFLOAT;
+    }
+  else if (priv->curve_type == GTK3_CURVE_TYPE_FREE)
+    {
+      /* sample i of a veclen vector is at min_x + i dx and reads free
+       * form sample i * n_samples / veclen, so those drawn lie beyond
+       * free_start / n_samples and, for veclen >= n_samples, before
+       * free_end / (n_samples - 1) of the range */
+      known = priv->free_generation == priv->generation &&
+              since == priv->generation - 1;
+      scale = priv->max_x - priv->min_x;
+      lo = priv->min_x + scale * priv->free_start / priv->n_samples;
+      hi = priv->min_x + scale * priv->free_end / (priv->n_samples - 1);
+    }
+  else
+    known = gtk3_curve_model_dirty_span (priv, since, 0.0, &lo, &hi, &error);
+
+  *x1 = MAX (lo, priv->min_x);
+  *x2 = MIN (hi, priv->max_x);
+  if (lo > hi)
+    {
+      *x1 = priv->max_x;
+      *x2 = priv->min_x;
+    }
+
+  g_mutex_unlock (&priv->lock);
+
+  return known;
+}
+
+/* Starts a batch of changes.  Until the matching
+ * gtk3_curve_model_end_update, "changed" and property notifications are
+ * held back, then each is emitted once.  Updates nest. */
+void
+gtk3_curve_model_begin_update (Gtk3CurveModel *model)
+{
+  Gtk3CurveModelPrivate *priv;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  priv = model->priv;
+
+  g_object_freeze_notify (G_OBJECT (model));
+
+  g_mutex_lock (&priv->lock);
+  priv->freeze_count++;
+  g_mutex_unlock (&priv->lock);
+}
+
+void
+gtk3_curve_model_end_update (Gtk3CurveModel *model)
+{
+  Gtk3CurveModelPrivate *priv;
+  gboolean emit;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+  if (priv->freeze_count <= 0)
+    {
+      g_mutex_unlock (&priv->lock);
+      g_critical ("gtk3_curve_model_end_update called without "
+                  "gtk3_curve_model_begin_update");
+      return;
+    }
+  emit = --priv->freeze_count == 0 && priv->changed_pending;
+  if (emit)
+    priv->changed_pending = FALSE;
+  g_mutex_unlock (&priv->lock);
+
+  DEBUG_INFO("model end update%s\n", emit ? ", changed" : "");
+
+  g_object_thaw_notify (G_OBJECT (model));
+  if (emit)
+    g_signal_emit (model, model_signals[CHANGED], 0);
+}
+
+/* The revision grows with every change of the model. */
+guint
+gtk3_curve_model_get_revision (Gtk3CurveModel *model)
+{
+  guint revision;
+
+  g_return_val_if_fail (GTK3_IS_CURVE_MODEL (model), 0);
+
+  g_mutex_lock (&model->priv->lock);
+  revision = model->priv->generation;
+  g_mutex_unlock (&model->priv->lock);
+
+  return revision;
+}
+
+/* Tells which samples of a veclen vector evaluated at revision since
+ * need to be evaluated again.  Returns FALSE if all of them do.
+ * Otherwise samples outside [start, end) are within error of the current
+ * curve; error is 0 except for splines, where spans that moved by no more
+ * than tolerance may be left out.  Only the change made by the last edit
+ * or two is known, so callers should keep up with every "changed". */
+gboolean
+gtk3_curve_model_get_dirty_range (Gtk3CurveModel *model,
+                                  guint           since,
+                                  gint            veclen,
+                                  gfloat          tolerance,
+                                  gint           *start,
+                                  gint           *end,
+                                  gfloat         *error)
+{
+  Gtk3CurveModelPrivate *priv;
+  gboolean known;
+
+  g_return_val_if_fail (GTK3_IS_CURVE_MODEL (model), FALSE);
+  g_return_val_if_fail (veclen > 1, FALSE);
+  g_return_val_if_fail (start != NULL && end != NULL && error != NULL, FALSE);
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+  known = gtk3_curve_model_dirty (priv, since, veclen, tolerance,
+                                  start, end, error);
+  g_mutex_unlock (&priv->lock);
+
+  return known;
+}
+
+void
+gtk3_curve_model_set_vector (Gtk3CurveModel *model,
+                             gint            veclen,
+                             gfloat          vector[])
+{
+  Gtk3CurveModelPrivate *priv;
+  Gtk3CurveType old_type;
+  gfloat ry;
+  gint i;
+
+  g_return_if_fail (GTK3_IS_CURVE_MODEL (model));
+  g_return_if_fail (veclen > 1);
+  priv = model->priv;
+
+  g_mutex_lock (&priv->lock);
+
+  old_type = priv->curve_type;
+  priv->curve_type = GTK3_CURVE_TYPE_FREE;
+  priv->generation++;
+  if (old_type != GTK3_CURVE_TYPE_FREE)
+    priv->layout_generation = priv->generation;
+
+  if (priv->n_samples != veclen)
+    {
+      g_free (priv->d_samples);
+      priv->n_samples = veclen;
+      priv->d_samples = g_malloc (priv->n_samples * sizeof (priv->d_samples[0]));
+    }
+
+  for (i = 0; i < veclen; ++i)
+    {
+      ry = vector[i];
+      if (ry > priv->max_y) ry = priv->max_y;
+      if (ry < priv->min_y) ry = priv->min_y;
+      priv->d_samples[i] = ry;
+    }
+
+  g_mutex_unlock (&priv->lock);
+
+  DEBUG_INFO("model set vector\n");
+
+  if (old_type != GTK3_CURVE_TYPE_FREE)
+    g_object_notify (G_OBJECT (model), "curve-type");
+  gtk3_curve_model_emit_changed (model);
+}
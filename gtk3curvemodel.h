@@ -0,0 +1,244 @@
+/* Copyright (C) 2016 Benoit Touchette
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation version
+ * 2.1 of the License.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTK3_CURVE_MODEL__H__
+#define __GTK3_CURVE_MODEL__H__
+
+#include <glib-object.h>
+
+#define GTK3_TYPE_CURVE_MODEL            (gtk3_curve_model_get_type ())
+#define GTK3_CURVE_MODEL(obj)            (G_TYPE_CHECK_INSTANCE_CAST ((obj), GTK3_TYPE_CURVE_MODEL, Gtk3CurveModel))
+#define GTK3_IS_CURVE_MODEL(obj)         (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GTK3_TYPE_CURVE_MODEL))
+#define GTK3_CURVE_MODEL_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST  ((klass), GTK3_TYPE_CURVE_MODEL, Gtk3CurveModelClass))
+#define GTK3_IS_CURVE_MODEL_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE  ((klass), GTK3_TYPE_CURVE_MODEL))
+#define GTK3_CURVE_MODEL_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS  ((obj), GTK3_TYPE_CURVE_MODEL, Gtk3CurveModelClass))
+
+#define GTK3_TYPE_CURVE_TYPE             (gtk3_curve_type_get_type ())
+
+/* number of free form samples used when the model has none yet */
+#define GTK3_CURVE_MODEL_FREE_SAMPLES    1024
+
+typedef enum
+{
+  GTK3_CURVE_TYPE_LINEAR,       /* linear interpolation */
+  GTK3_CURVE_TYPE_SPLINE,       /* spline interpolation */
+  GTK3_CURVE_TYPE_FREE,         /* free form curve */
+  GTK3_CURVE_TYPE_MONOTONE,     /* monotone cubic interpolation */
+  GTK3_CURVE_TYPE_CATMULL_ROM,  /* Catmull-Rom spline, with tension */
+  GTK3_CURVE_TYPE_BEZIER,       /* cubic Bezier, with handles */
+  GTK3_CURVE_TYPE_BSPLINE,      /* uniform cubic B-spline */
+
+  /* Analytic curves, given by their parameters (see
+   * gtk3_curve_model_set_parameters) rather than points, evaluated to
+   * within 2^-20 of the y range (2^-18 at the lowest contrast).  With x
+   * and y scaled to 0..1 over the range: */
+  GTK3_CURVE_TYPE_GAMMA,        /* x^(1 / gamma); gamma (1 unless
+                                 * positive), default 1 */
+  GTK3_CURVE_TYPE_SIGMOID,      /* logistic S curve around midpoint,
+                                 * scaled to end at the corners; contrast
+                                 * (at least 0.1), midpoint; 10, 0.5 */
+  GTK3_CURVE_TYPE_LOG,          /* log(1 + strength x) / log(1 + strength);
+                                 * strength (at least 0.1), 10 */
+  GTK3_CURVE_TYPE_POWER,        /* offset + gain x^exponent; exponent,
+                                 * gain, offset; 1, 1, 0 */
+  GTK3_CURVE_TYPE_TRANSFER      /* a Gtk3CurveTransfer; transfer,
+                                 * default sRGB */
+} Gtk3CurveType;
+
+/* Standard transfer functions, from linear light to the signal, and
+ * their inverses (_INVERSE), from the signal back to linear light.  PQ
+ * linear light is relative to 10000 cd/m2, HLG to its nominal peak. */
+typedef enum
+{
+  GTK3_CURVE_TRANSFER_SRGB,             /* IEC 61966-2-1 */
+  GTK3_CURVE_TRANSFER_SRGB_INVERSE,
+  GTK3_CURVE_TRANSFER_REC709,           /* ITU-R BT.709 OETF */
+  GTK3_CURVE_TRANSFER_REC709_INVERSE,
+  GTK3_CURVE_TRANSFER_PQ,               /* SMPTE ST 2084 inverse EOTF */
+  GTK3_CURVE_TRANSFER_PQ_INVERSE,
+  GTK3_CURVE_TRANSFER_HLG,              /* ITU-R BT.2100 HLG OETF */
+  GTK3_CURVE_TRANSFER_HLG_INVERSE
+} Gtk3CurveTransfer;
+
+/* Element types gtk3_curve_model_get_vector_full writes. */
+typedef enum
+{
+  GTK3_CURVE_FORMAT_FLOAT,
+  GTK3_CURVE_FORMAT_DOUBLE
+} Gtk3CurveFormat;
+
+typedef struct _Gtk3CurveModel         Gtk3CurveModel;
+typedef struct _Gtk3CurveModelClass    Gtk3CurveModelClass;
+typedef struct _Gtk3CurveModelPrivate  Gtk3CurveModelPrivate;
+typedef struct _Gtk3CurveVector        Gtk3CurveVector;
+
+struct _Gtk3CurveVector
+{
+  gfloat x;
+  gfloat y;
+};
+
+/* Gtk3CurveModel holds the control points, range and curve type of a
+ * curve and evaluates it.  It does not depend on a display, so it can
+ * be used from batch jobs, and its query functions (getters and
+ * gtk3_curve_model_get_vector) may be called from any thread.  Changes
+ * emit "changed" in the thread that made them; models that drive a
+ * Gtk3Curve must therefore only be modified from the main thread.
+ * Very long vectors are evaluated in parallel on a thread pool shared
+ * by all models.
+ */
+struct _Gtk3CurveModel
+{
+  GObject parent_instance;
+  Gtk3CurveModelPrivate *priv;
+};
+
+struct _Gtk3CurveModelClass
+{
+  GObjectClass parent_class;
+
+  void (* changed) (Gtk3CurveModel *model);
+
+  /* Padding for future expansion */
+  void (*_gtk_reserved1) (void);
+  void (*_gtk_reserved2) (void);
+  void (*_gtk_reserved3) (void);
+  void (*_gtk_reserved4) (void);
+};
+
+GType gtk3_curve_type_get_type (void);
+GType gtk3_curve_model_get_type (void) G_GNUC_CONST;
+Gtk3CurveModel *gtk3_curve_model_new (void);
+
+void gtk3_curve_model_reset                       (Gtk3CurveModel    *model);
+void gtk3_curve_model_set_range                   (Gtk3CurveModel    *model,
+                                                   gfloat             min_x,
+                                                   gfloat             max_x,
+                                                   gfloat             min_y,
+                                                   gfloat             max_y);
+void gtk3_curve_model_get_range                   (Gtk3CurveModel    *model,
+                                                   gfloat            *min_x,
+                                                   gfloat            *max_x,
+                                                   gfloat            *min_y,
+                                                   gfloat            *max_y);
+void gtk3_curve_model_set_curve_type              (Gtk3CurveModel    *model,
+                                                   Gtk3CurveType      type);
+Gtk3CurveType gtk3_curve_model_get_curve_type     (Gtk3CurveModel    *model);
+
+gint gtk3_curve_model_get_n_points                (Gtk3CurveModel    *model);
+gboolean gtk3_curve_model_get_point               (Gtk3CurveModel    *model,
+                                                   gint               index,
+                                                   gfloat            *x,
+                                                   gfloat            *y);
+void gtk3_curve_model_set_point                   (Gtk3CurveModel    *model,
+                                                   gint               index,
+                                                   gfloat             x,
+                                                   gfloat             y);
+void gtk3_curve_model_insert_point                (Gtk3CurveModel    *model,
+                                                   gint               index,
+                                                   gfloat             x,
+                                                   gfloat             y);
+void gtk3_curve_model_remove_inactive_points      (Gtk3CurveModel    *model);
+void gtk3_curve_model_set_points                  (Gtk3CurveModel    *model,
+                                                   gint               n_points,
+                                                   const Gtk3CurveVector points[]);
+gint gtk3_curve_model_get_points                  (Gtk3CurveModel    *model,
+                                                   gint               n_points,
+                                                   Gtk3CurveVector    points[]);
+void gtk3_curve_model_set_handles                 (Gtk3CurveModel    *model,
+                                                   gint               index,
+                                                   gfloat             in_slope,
+                                                   gfloat             out_slope);
+gboolean gtk3_curve_model_get_handles             (Gtk3CurveModel    *model,
+                                                   gint               index,
+                                                   gfloat            *in_slope,
+                                                   gfloat            *out_slope);
+void gtk3_curve_model_set_tension                 (Gtk3CurveModel    *model,
+                                                   gfloat             tension);
+gfloat gtk3_curve_model_get_tension               (Gtk3CurveModel    *model);
+
+void gtk3_curve_model_set_free_segment            (Gtk3CurveModel    *model,
+                                                   gfloat             x1,
+                                                   gfloat             y1,
+                                                   gfloat             x2,
+                                                   gfloat             y2);
+void gtk3_curve_model_set_parameters              (Gtk3CurveModel    *model,
+                                                   Gtk3CurveType      type,
+                                                   gint               n_params,
+                                                   const gfloat       params[]);
+gint gtk3_curve_model_get_parameters              (Gtk3CurveModel    *model,
+                                                   Gtk3CurveType      type,
+                                                   gint               n_params,
+                                                   gfloat             params[]);
+void gtk3_curve_model_set_gamma                   (Gtk3CurveModel    *model,
+                                                   gfloat             gamma_);
+void gtk3_curve_model_set_sigmoid                 (Gtk3CurveModel    *model,
+                                                   gfloat             contrast,
+                                                   gfloat             midpoint);
+void gtk3_curve_model_set_log                     (Gtk3CurveModel    *model,
+                                                   gfloat             strength);
+void gtk3_curve_model_set_power                   (Gtk3CurveModel    *model,
+                                                   gfloat             exponent,
+                                                   gfloat             gain,
+                                                   gfloat             offset);
+void gtk3_curve_model_set_transfer                (Gtk3CurveModel    *model,
+                                                   Gtk3CurveTransfer  transfer);
+void gtk3_curve_model_get_vector                  (Gtk3CurveModel    *model,
+                                                   gint               veclen,
+                                                   gfloat             vector[]);
+void gtk3_curve_model_get_vector_range            (Gtk3CurveModel    *model,
+                                                   gint               veclen,
+                                                   gint               start,
+                                                   gint               end,
+                                                   gfloat             vector[]);
+void gtk3_curve_model_eval_points                 (Gtk3CurveModel    *model,
+                                                   const gfloat       x[],
+                                                   gfloat             y[],
+                                                   gint               n);
+gfloat gtk3_curve_model_eval                      (Gtk3CurveModel    *model,
+                                                   gfloat             x);
+void gtk3_curve_model_get_vector_full             (Gtk3CurveModel    *model,
+                                                   gint               veclen,
+                                                   Gtk3CurveFormat    format,
+                                                   gpointer           data,
+                                                   gint               offset,
+                                                   gint               stride);
+void gtk3_curve_model_get_lut_u8                  (Gtk3CurveModel    *model,
+                                                   guint8             lut[256]);
+void gtk3_curve_model_get_lut_u16                 (Gtk3CurveModel    *model,
+                                                   gint               bits,
+                                                   guint16            lut[]);
+void gtk3_curve_model_set_vector                  (Gtk3CurveModel    *model,
+                                                   gint               veclen,
+                                                   gfloat             vector[]);
+
+void gtk3_curve_model_begin_update                (Gtk3CurveModel    *model);
+void gtk3_curve_model_end_update                  (Gtk3CurveModel    *model);
+
+guint gtk3_curve_model_get_revision               (Gtk3CurveModel    *model);
+gboolean gtk3_curve_model_get_dirty_range         (Gtk3CurveModel    *model,
+                                                   guint              since,
+                                                   gint               veclen,
+                                                   gfloat             tolerance,
+                                                   gint              *start,
+                                                   gint              *end,
+                                                   gfloat            *error);
+gboolean gtk3_curve_model_get_dirty_interval      (Gtk3CurveModel    *model,
+                                                   guint              since,
+                                                   gfloat            *x1,
+                                                   gfloat            *x2);
+
+#endif /* __GTK3_CURVE_MODEL__H__ */
@@ -54,6 +54,18 @@ static const gchar * button_images[] = {
 	"/images/reset.png"
 };
 
+static const gchar * transfer_names[] = {
+	"Power law" ,
+	"sRGB" ,
+	"sRGB inverse" ,
+	"Rec. 709" ,
+	"Rec. 709 inverse" ,
+	"PQ" ,
+	"PQ inverse" ,
+	"HLG" ,
+	"HLG inverse"
+};
+
 enum
   {
     LINEAR = 0,
@@ -84,6 +96,7 @@ gtk3_gamma_curve_init (Gtk3GammaCurve *curve)
   gtk_orientable_set_orientation (GTK_ORIENTABLE (curve), GTK_ORIENTATION_VERTICAL);
   
   curve->gamma = 1.0;
+  curve->transfer = 0;
 
   // curve->table = gtk_table_new (1, 2, FALSE);
   curve->table = gtk_grid_new ();
@@ -202,7 +215,12 @@ gamma_response_callback (GtkWidget *w,
                   if (end > start && v > 0.0)
 	                   c->gamma = v;
              }
-          gtk3_curve_set_gamma (c->curve, c->gamma);
+
+           c->transfer = gtk_combo_box_get_active (GTK_COMBO_BOX (c->transfer_combo));
+           if (c->transfer > 0)
+             gtk3_curve_set_transfer (c->curve, c->transfer - 1);
+           else
+             gtk3_curve_set_gamma (c->curve, c->gamma);
 	  }
    gamma_cancel_callback (w, data);
 }
@@ -223,6 +241,7 @@ button_clicked_callback (GtkWidget *w, gpointer data)
 	{
 	  GtkWidget *vbox, *hbox, *label, *button;
 	  gchar buf[64];
+	  guint i;
 	  
 	  c->gamma_dialog = gtk_dialog_new_with_buttons ("Gamma",
 	                                                                                       GTK_WINDOW (w),
@@ -243,6 +262,29 @@ button_clicked_callback (GtkWidget *w, gpointer data)
 	  // GTK4 => gtk_box_append (GTK_BOX (vbox), hbox);
 	  gtk_widget_show (hbox);
 	  
+	  label = gtk_label_new_with_mnemonic ("_Curve");
+	  gtk_box_pack_start (GTK_BOX (hbox), label, FALSE, FALSE, 2);
+	  // GTK4 => gtk_box_append (GTK_BOX (hbox), label);
+	  gtk_widget_show (label);
+
+	  /* in Gtk3CurveTransfer order, after the power law */
+	  c->transfer_combo = gtk_combo_box_text_new ();
+	  for (i = 0; i < G_N_ELEMENTS (transfer_names); i++)
+	    gtk_combo_box_text_append_text (GTK_COMBO_BOX_TEXT (c->transfer_combo),
+	                                    transfer_names[i]);
+	  gtk_combo_box_set_active (GTK_COMBO_BOX (c->transfer_combo), c->transfer);
+      gtk_label_set_mnemonic_widget (GTK_LABEL (label), c->transfer_combo);
+	  gtk_box_pack_start (GTK_BOX (hbox), c->transfer_combo, TRUE, TRUE, 2);
+	  // GTK4 => gtk_box_append (GTK_BOX (hbox), c->transfer_combo);
+	  gtk_widget_show (c->transfer_combo);
+
+	  hbox = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, /* spacing */ 0);
+      gtk_box_set_homogeneous (GTK_BOX (hbox), FALSE);
+
+	  gtk_box_pack_start (GTK_BOX (vbox), hbox, TRUE, TRUE, 2);
+	  // GTK4 => gtk_box_append (GTK_BOX (vbox), hbox);
+	  gtk_widget_show (hbox);
+
 	  label = gtk_label_new_with_mnemonic ("_Gamma value");
 	  gtk_box_pack_start (GTK_BOX (hbox), label, FALSE, FALSE, 2);
 	  // GTK4 => gtk_box_append (GTK_BOX (hbox), label);
@@ -284,7 +326,12 @@ curve_type_changed_callback (GtkWidget *w, gpointer data)
     {
     case GTK3_CURVE_TYPE_SPLINE: active = 0; break;
     case GTK3_CURVE_TYPE_LINEAR: active = 1; break;
-    default:		        active = 2; break;
+    case GTK3_CURVE_TYPE_FREE:   active = 2; break;
+    default:
+      /* no button for it, as after setting a gamma */
+      for (active = 0; active < 3; ++active)
+        gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (c->button[active]), FALSE);
+      return;
     }
   if (!gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON (c->button[active])))
     gtk_toggle_button_set_active (GTK_TOGGLE_BUTTON (c->button[active]), TRUE);
@@ -52,6 +52,8 @@ struct _Gtk3GammaCurve
   gfloat gamma;
   GtkWidget *gamma_dialog;
   GtkWidget *gamma_text;
+  gint transfer;	/* 0 power law, else Gtk3CurveTransfer + 1 */
+  GtkWidget *transfer_combo;
 };
 
 struct _Gtk3GammaCurveClass